@@ -0,0 +1,305 @@
+// gamelogic benchmark:
+// drives the simulation alone (no networking) for many ticks,
+// and reports its throughput, broken down by phase.
+// The inputs are either scripted (random, seeded), or replayed from a demo file.
+#include <cstdio>
+#include <cstdlib> // atoi, malloc
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include "clock.h"
+#include "demo.h"
+#include "gamelogic.h"
+#include "span.h"
+
+namespace
+{
+int64_t g_allocCount = 0;
+
+struct Config
+{
+  int64_t ticks = 1000000;
+  int heroCount = 4;
+  uint64_t seed = 1;
+  bool instantChains = false;
+  bool fixedPoint = false;
+  MapPreset preset = MapPreset::Classic; // overridden by the demo, if any
+  std::string demoPath;
+};
+
+// Holds direction keys for a while, drops bombs from time to time.
+template<int MaxHeroes>
+void generateInputs(Rng& rng, PlayerInputState inputs[MaxHeroes])
+{
+  for(int i = 0; i < MaxHeroes; ++i)
+  {
+    auto& in = inputs[i];
+
+    if(rng(16) == 0)
+    {
+      in = {};
+
+      switch(rng(5))
+      {
+      case 0: in.left = true;
+        break;
+      case 1: in.right = true;
+        break;
+      case 2: in.up = true;
+        break;
+      case 3: in.down = true;
+        break;
+      }
+    }
+
+    in.dropBomb = rng(20) == 0;
+  }
+}
+
+// Source of the per-tick inputs, and of the state resets.
+template<typename State>
+struct InputSource
+{
+  using GameMatch = BasicGameMatch<State>;
+
+  virtual ~InputSource() = default;
+
+  // Returns the inputs for the next tick.
+  // Might replace 'match' and 'state' before that.
+  virtual void next(GameMatch& match, State& state, PlayerInputState inputs[State::MAX_HEROES]) = 0;
+};
+
+template<typename State>
+struct ScriptedInputs : InputSource<State>
+{
+  using typename InputSource<State>::GameMatch;
+
+  ScriptedInputs(const Config& config) : heroCount(config.heroCount), instantChains(config.instantChains), fixedPoint(config.fixedPoint)
+  {
+    rng.seed(config.seed);
+  }
+
+  void next(GameMatch& match, State& state, PlayerInputState inputs[State::MAX_HEROES]) override
+  {
+    if(first)
+    {
+      first = false;
+      match.rng.seed(rng.next());
+      match.instantChains = instantChains;
+      match.fixedPoint = fixedPoint;
+      state = initGame(match);
+
+      for(int i = 0; i < heroCount; ++i)
+        state.heroes[i].enable = true;
+    }
+
+    generateInputs<State::MAX_HEROES>(rng, inputs);
+  }
+
+  const int heroCount;
+  const bool instantChains;
+  const bool fixedPoint;
+  bool first = true;
+  Rng rng;
+};
+
+// Loops over a demo file.
+template<typename State>
+struct DemoInputs : InputSource<State>
+{
+  using typename InputSource<State>::GameMatch;
+  using Reader = BasicDemoReader<State>;
+
+  DemoInputs(const Config& config) : path(config.demoPath)
+  {
+  }
+
+  void next(GameMatch& match, State& state, PlayerInputState inputs[State::MAX_HEROES]) override
+  {
+    for(;;)
+    {
+      if(!reader)
+        reader = std::make_unique<Reader>(path.c_str());
+
+      switch(reader->next())
+      {
+      case Reader::End:
+        {
+          if(!tickCount)
+            throw std::runtime_error("Demo contains no ticks");
+
+          reader.reset(); // loop
+          break;
+        }
+      case Reader::Reset:
+      case Reader::Checkpoint:
+        {
+          // keep our own settings and measurements
+          const auto profile = match.profile;
+          const auto verbose = match.verbose;
+          match = reader->match;
+          match.profile = profile;
+          match.verbose = verbose;
+          state = reader->state;
+          break;
+        }
+      case Reader::Tick:
+        for(int i = 0; i < State::MAX_HEROES; ++i)
+          inputs[i] = reader->inputs[i];
+
+        ++tickCount;
+        return;
+      }
+    }
+  }
+
+  const std::string path;
+  std::unique_ptr<Reader> reader;
+  int64_t tickCount = 0;
+};
+
+Config parseCommandLine(Span<const String> args)
+{
+  Config config;
+
+  auto stringArg = [&] (int& i)
+    {
+      if(i + 1 >= args.len)
+        throw std::runtime_error("Missing value for option");
+
+      ++i;
+      return std::string(args[i].data, args[i].len);
+    };
+
+  for(int i = 1; i < args.len; ++i)
+  {
+    const std::string arg(args[i].data, args[i].len);
+
+    if(arg == "--ticks")
+      config.ticks = atoll(stringArg(i).c_str());
+    else if(arg == "--heroes")
+      config.heroCount = atoi(stringArg(i).c_str());
+    else if(arg == "--seed")
+      config.seed = atoll(stringArg(i).c_str());
+    else if(arg == "--instant-chains")
+      config.instantChains = true;
+    else if(arg == "--fixed-point")
+      config.fixedPoint = true;
+    else if(arg == "--preset")
+    {
+      const auto name = stringArg(i);
+
+      if(!parseMapPreset(name.c_str(), config.preset))
+        throw std::runtime_error("Unknown map preset: '" + name + "'");
+    }
+    else if(arg == "--demo")
+      config.demoPath = stringArg(i);
+    else
+      throw std::runtime_error("Unknown option: '" + arg + "'");
+  }
+
+  if(!config.demoPath.empty())
+    config.preset = readDemoPreset(config.demoPath.c_str());
+
+  int maxHeroes = 0;
+  visitPreset(config.preset, [&] (auto tag) { maxHeroes = spawnCount<typename decltype(tag)::type>(); });
+
+  if(config.heroCount < 1 || config.heroCount > maxHeroes)
+    throw std::runtime_error("Invalid hero count");
+
+  return config;
+}
+}
+
+// Count the allocations done while simulating
+void* operator new (size_t size)
+{
+  ++g_allocCount;
+
+  if(void* p = malloc(size ? size : 1))
+    return p;
+
+  throw std::bad_alloc();
+}
+
+void operator delete (void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete (void* p, size_t) noexcept
+{
+  free(p);
+}
+
+namespace
+{
+template<typename State>
+void run(const Config& config)
+{
+  std::unique_ptr<InputSource<State>> source;
+
+  if(config.demoPath.empty())
+    source = std::make_unique<ScriptedInputs<State>>(config);
+  else
+    source = std::make_unique<DemoInputs<State>>(config);
+
+  // heap-allocated, so the inner loop doesn't have to copy them around
+  auto match = std::make_unique<BasicGameMatch<State>>();
+  auto state = std::make_unique<State>();
+  PlayerInputState inputs[State::MAX_HEROES] {};
+
+  match->verbose = false;
+  match->profile.enabled = true;
+
+  // warm-up
+  source->next(*match, *state, inputs);
+
+  printf("Simulating %lld ticks (%s, map %s)\n", (long long)config.ticks,
+         config.demoPath.empty() ? "scripted inputs" : config.demoPath.c_str(), mapPresetName(State::PRESET));
+
+  int64_t sourceNs = 0;
+  int64_t sourceAllocs = 0;
+  int64_t games = 0;
+  const int64_t allocsBefore = g_allocCount;
+  const int64_t start = getMonotonicTimeNs();
+
+  for(int64_t tick = 0; tick < config.ticks; ++tick)
+  {
+    // don't count the input source in the measurements
+    const int64_t t0 = getMonotonicTimeNs();
+    const int64_t allocs0 = g_allocCount;
+    source->next(*match, *state, inputs);
+    sourceAllocs += g_allocCount - allocs0;
+    sourceNs += getMonotonicTimeNs() - t0;
+
+    const bool wasOver = match->intergameTimer > 0;
+    *state = advanceGameLogic(*match, *state, inputs);
+
+    if(!wasOver && match->intergameTimer > 0)
+      ++games;
+  }
+
+  const int64_t elapsed = getMonotonicTimeNs() - start - sourceNs;
+  const int64_t allocs = g_allocCount - allocsBefore - sourceAllocs;
+  const double ticks = double(config.ticks);
+  const auto& profile = match->profile;
+
+  printf("games played: %lld\n", (long long)games);
+  printf("ticks/s: %.0f\n", ticks * 1e9 / elapsed);
+  printf("ns/tick: %.1f\n", elapsed / ticks);
+  printf("  flame coverage: %.1f\n", profile.flamesNs / ticks);
+  printf("  heroes update: %.1f\n", profile.heroesNs / ticks);
+  printf("  bombs update: %.1f\n", profile.bombsNs / ticks);
+  printf("  other (incl. profiling): %.1f\n", (elapsed - profile.flamesNs - profile.heroesNs - profile.bombsNs) / ticks);
+  printf("allocations: %lld (%.3f/tick)\n", (long long)allocs, allocs / ticks);
+}
+}
+
+void safeMain(Span<const String> args)
+{
+  const auto config = parseCommandLine(args);
+  visitPreset(config.preset, [&] (auto tag) { run<typename decltype(tag)::type>(config); });
+}
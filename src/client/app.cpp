@@ -1,12 +1,17 @@
 #include "app.h"
+#include "prediction.h"
 #include "protocol.h"
 #include "scenes.h"
 #include "socket.h"
+#include <algorithm> // min
 #include <chrono>
 #include <cstdio>
+#include <cstdlib> // atoi
 #include <stdexcept>
+#include <string>
 
 Socket g_sock(0);
+uint32_t g_lastStateSeq = 0; // last snapshot decoded, acknowledged to the server
 
 int GetTicks()
 {
@@ -19,28 +24,43 @@ int GetTicks()
 namespace
 {
 Address g_address;
+int g_roomId = 0;
 int lastSentPacketDate = 0;
+int lastInputDate = 0;
+uint32_t g_inputSeq = 0; // of the last input sent
+uint8_t g_sentInputs[MaxInputHistory]; // packed, by sequence number modulo MaxInputHistory
+bool g_bombPressed = false; // since the last input sent, so a short press isn't missed
 SceneFuncStruct g_currScene { &sceneIngame };
 
 template<typename T>
-void sendPacket(const T& pkt)
+void sendPacket(T pkt)
 {
+  pkt.hdr.roomId = g_roomId;
   g_sock.send(g_address, { (const uint8_t*)&pkt, int(sizeof pkt) });
   lastSentPacketDate = GetTicks();
 }
 
 void sendKeepAlive()
 {
-  const uint8_t pkt[] = { Op::KeepAlive };
+  PacketKeepAlive pkt {};
+  pkt.hdr.op = Op::KeepAlive;
+  pkt.preset = GameLogicState::PRESET; // the only map we can draw
   sendPacket(pkt);
 }
 }
 
 void AppInit(Span<const String> args)
 {
-  const auto host = args.len == 2 ? args[1] : "code.alaiwan.org";
+  const auto host = args.len >= 2 ? args[1] : "code.alaiwan.org";
   g_address = Socket::resolve(host, ServerUdpPort);
-  printf("Connecting to: %.*s (%s)\n", host.len, host.data, g_address.toString().c_str());
+
+  if(args.len >= 3)
+    g_roomId = atoi(std::string(args[2].data, args[2].len).c_str());
+
+  if(g_roomId < 0 || g_roomId >= MaxRooms)
+    throw std::runtime_error("Invalid room id");
+
+  printf("Connecting to: %.*s (%s), room %d\n", host.len, host.data, g_address.toString().c_str(), g_roomId);
 
   sendKeepAlive();
 }
@@ -48,8 +68,9 @@ void AppInit(Span<const String> args)
 void AppExit()
 {
   {
-    const uint8_t pkt[] = { Op::Disconnect };
-    g_sock.send(g_address, pkt);
+    PacketDisconnect pkt {};
+    pkt.hdr.op = Op::Disconnect;
+    sendPacket(pkt);
   }
 }
 
@@ -65,19 +86,44 @@ bool AppTick(SteamGui* ui, Span<const uint8_t> keys)
     sendPacket(pkt);
   }
 
-  // send inputs to server
+  auto now = GetTicks();
+
+  // send inputs to server, one per game tick, as the server applies them
+  g_bombPressed |= bool(keys[Key::Space]);
+
+  if(now - lastInputDate >= GamePeriodMs)
   {
+    lastInputDate += GamePeriodMs;
+
+    // don't try to catch up after a long frame
+    if(now - lastInputDate >= GamePeriodMs)
+      lastInputDate = now;
+
+    PlayerInputState input {};
+    input.left = keys[Key::Left];
+    input.right = keys[Key::Right];
+    input.up = keys[Key::Up];
+    input.down = keys[Key::Down];
+    input.dropBomb = g_bombPressed;
+    g_bombPressed = false;
+
+    ++g_inputSeq;
+    g_sentInputs[g_inputSeq % MaxInputHistory] = packInput(input);
+
+    // the newest first, and the previous ones in case they were lost
     PacketPlayerInput pkt {};
     pkt.hdr.op = Op::PlayerInput;
-    pkt.input.left = keys[Key::Left];
-    pkt.input.right = keys[Key::Right];
-    pkt.input.up = keys[Key::Up];
-    pkt.input.down = keys[Key::Down];
-    pkt.input.dropBomb = keys[Key::Space];
+    pkt.inputSeq = g_inputSeq;
+    pkt.ackSeq = g_lastStateSeq;
+    pkt.inputCount = std::min<uint32_t>(g_inputSeq, MaxInputHistory);
+
+    for(int i = 0; i < pkt.inputCount; ++i)
+      pkt.inputs[i] = g_sentInputs[(g_inputSeq - i) % MaxInputHistory];
+
     sendPacket(pkt);
-  }
 
-  auto now = GetTicks();
+    predictInput(g_inputSeq, input);
+  }
 
   if(now - lastSentPacketDate > 2000)
     sendKeepAlive();
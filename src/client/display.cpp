@@ -8,6 +8,7 @@
 #include <SDL.h>
 
 #include "picture.h"
+#include "profiler.h"
 #include "trianglebag.h"
 
 #ifdef NDEBUG
@@ -106,7 +107,10 @@ void main()
 
 void drawScreen(SDL_Window* window, int vbo, int transfoLoc, int colormodeLoc, std::vector<TriangleBag> const& bags)
 {
-  AutoProfile aprof("Draw Time (ms)");
+  static const auto s_drawTime = registerStat("Draw Time (ms)");
+  static const auto s_drawCalls = registerStat("Draw Calls");
+
+  AutoProfile aprof(s_drawTime);
   glClearColor(0.10, 0.10, 0.20, 1);
   glClear(GL_COLOR_BUFFER_BIT);
 
@@ -144,7 +148,7 @@ void drawScreen(SDL_Window* window, int vbo, int transfoLoc, int colormodeLoc, s
     glDrawArrays(GL_TRIANGLES, 0, bag.triangles.size());
   }
 
-  Stat("Draw Calls", bags.size());
+  Stat(s_drawCalls, bags.size());
 }
 
 int transfoLoc, colormodeLoc;
@@ -213,7 +217,13 @@ void display_cleanup()
 void display_refresh()
 {
   drawScreen(window, vbo, transfoLoc, colormodeLoc, g_Bags);
-  SDL_GL_SwapWindow(window);
+
+  {
+    static const auto s_swap = registerStat("Swap (ms)");
+    AutoProfile aprof(s_swap);
+    SDL_GL_SwapWindow(window);
+  }
+
   g_Bags.clear();
 }
 
@@ -0,0 +1,148 @@
+#include "interpolation.h"
+
+#include <algorithm> // min, max
+#include <cmath> // abs
+
+#include "protocol.h" // GamePeriodMs
+#include "stats.h"
+
+namespace
+{
+const int64_t TickNs = GamePeriodMs * 1000000ll;
+const int64_t MaxDelayNs = 250 * 1000000ll;
+const int64_t DelayMarginNs = 2 * 1000000ll;
+const float MaxLerpDistance = 2; // in cells: farther moves are teleports, e.g a new game
+
+const int BufferSize = 16; // the newest snapshots
+const int TransitHistory = 64; // the newest arrivals
+
+struct TimedSnapshot
+{
+  uint32_t seq;
+  uint32_t tick;
+  GameLogicState state;
+};
+
+TimedSnapshot g_snapshots[BufferSize]; // by arrival order, modulo BufferSize
+int64_t g_count = 0; // snapshots pushed so far
+
+// Arrival date minus the date of the tick on the server, give or take the
+// offset between the two clocks: the fastest arrival gives this offset.
+int64_t g_transits[TransitHistory];
+int64_t g_transitCount = 0;
+double g_jitterNs = 0; // mean deviation between consecutive transits, as in RFC 3550
+
+int64_t g_delayNs = 0; // behind the fastest arrival
+int64_t g_lastDate = -1; // of the previous interpolation
+
+// Moves the heroes and the bombs of 'out' towards 'to'.
+void lerpEntities(GameLogicState& out, const GameLogicState& to, float alpha)
+{
+  auto lerp = [alpha] (Vec2f& pos, Vec2f target)
+    {
+      if(std::abs(target.x - pos.x) + std::abs(target.y - pos.y) < MaxLerpDistance)
+        pos = pos + (target - pos) * alpha;
+    };
+
+  for(int i = 0; i < GameLogicState::MAX_HEROES; ++i)
+  {
+    if(out.heroes[i].enable && to.heroes[i].enable)
+      lerp(out.heroes[i].pos, to.heroes[i].pos);
+  }
+
+  for(int i = out.bombs.next(-1); i >= 0; i = out.bombs.next(i))
+  {
+    if(to.bombs.isLive(i) && to.bombs[i].ownerIndex == out.bombs[i].ownerIndex)
+      lerp(out.bombs[i].pos, to.bombs[i].pos);
+  }
+}
+}
+
+void pushSnapshot(const GameLogicState& state, uint32_t seq, uint32_t tick, int64_t now)
+{
+  if(g_count > 0)
+  {
+    const auto& newest = g_snapshots[(g_count - 1) % BufferSize];
+
+    if(seq <= newest.seq || tick <= newest.tick)
+      return;
+  }
+
+  const int64_t transit = now - int64_t(tick) * TickNs;
+
+  if(g_transitCount > 0)
+  {
+    const int64_t prev = g_transits[(g_transitCount - 1) % TransitHistory];
+    g_jitterNs += (std::abs(double(transit - prev)) - g_jitterNs) / 16;
+  }
+
+  g_transits[g_transitCount++ % TransitHistory] = transit;
+
+  auto& slot = g_snapshots[g_count++ % BufferSize];
+  slot.seq = seq;
+  slot.tick = tick;
+  slot.state = state;
+}
+
+void resetSnapshots()
+{
+  g_count = 0;
+  g_transitCount = 0;
+  g_jitterNs = 0;
+  g_delayNs = 0;
+  g_lastDate = -1;
+}
+
+bool interpolateSnapshots(int64_t now, GameLogicState& out)
+{
+  static const auto s_delay = registerStat("Interp Delay (ms)");
+  static const auto s_jitter = registerStat("Jitter (ms)");
+
+  if(g_count == 0)
+    return false;
+
+  int64_t fastest = g_transits[0];
+
+  for(int i = 1; i < std::min<int64_t>(g_transitCount, TransitHistory); ++i)
+    fastest = std::min(fastest, g_transits[i]);
+
+  // One tick, so the next snapshot is there before the drawn date reaches
+  // it, plus what the late arrivals need.
+  // Moves towards the wanted delay by at most 10% of the elapsed time,
+  // so the drawn date never goes backwards.
+  const int64_t wanted = std::min(MaxDelayNs, TickNs + int64_t(3 * g_jitterNs) + DelayMarginNs);
+  const int64_t maxStep = g_lastDate < 0 ? MaxDelayNs : (now - g_lastDate) / 10;
+  g_delayNs += std::max(-maxStep, std::min(maxStep, wanted - g_delayNs));
+  g_lastDate = now;
+
+  Stat(s_delay, g_delayNs / 1000000.0);
+  Stat(s_jitter, g_jitterNs / 1000000.0);
+
+  // in server ticks
+  const double date = double(now - fastest - g_delayNs) / TickNs;
+
+  // the first snapshot at or after the drawn date
+  const int64_t first = std::max<int64_t>(0, g_count - BufferSize);
+  int64_t next = first;
+
+  while(next < g_count && g_snapshots[next % BufferSize].tick < date)
+    ++next;
+
+  if(next == g_count || next == first)
+  {
+    out = g_snapshots[std::min(next, g_count - 1) % BufferSize].state;
+    return true;
+  }
+
+  const auto& prev = g_snapshots[(next - 1) % BufferSize];
+  const auto& curr = g_snapshots[next % BufferSize];
+
+  // The state didn't change between two snapshots: the move from 'prev'
+  // to 'curr' happened during the last tick.
+  const double from = std::max(prev.tick, curr.tick - 1);
+  const float alpha = std::max(0.0, std::min(1.0, (date - from) / (curr.tick - from)));
+
+  out = prev.state;
+  lerpEntities(out, curr.state, alpha);
+  return true;
+}
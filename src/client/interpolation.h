@@ -0,0 +1,21 @@
+// Snapshot interpolation.
+// The snapshots are stamped with the server tick they were taken at.
+// They are buffered, and drawn a little in the past, so there are usually
+// two of them around the drawn date: the heroes and the bombs are drawn
+// between them, instead of stepping at the server tick rate.
+// The delay adapts to the jitter measured on the arrivals.
+#pragma once
+
+#include <stdint.h>
+
+#include "game.h"
+
+// 'state' has just been decoded, at 'now' (see getMonotonicTimeNs).
+// Late and out-of-order snapshots are dropped.
+void pushSnapshot(const GameLogicState& state, uint32_t seq, uint32_t tick, int64_t now);
+
+// Forgets the buffered snapshots and arrival times, e.g after a server restart.
+void resetSnapshots();
+
+// Returns false if no snapshot was received yet.
+bool interpolateSnapshots(int64_t now, GameLogicState& out);
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <chrono>
+#include <ctime> // time
 #include <cstdio>
 #include <string>
 #include <thread>
@@ -12,6 +13,7 @@
 #include "display.h"
 #include "file.h"
 #include "picture.h"
+#include "profiler.h"
 #include "span.h"
 #include "sprite.h"
 #include "stats.h"
@@ -114,7 +116,8 @@ std::vector<Stamp> g_Stamps;
 
 Picture CreateAtlas(const std::vector<Picture>& allPics)
 {
-  AutoProfile ap("Atlas creation (ms)");
+  static const auto s_atlasCreation = registerStat("Atlas creation (ms)");
+  AutoProfile ap(s_atlasCreation);
 
   static auto blitPicture = [] (Picture& dst, const Picture& src, Vec2i pos)
     {
@@ -172,7 +175,8 @@ Picture CreateAtlas(const std::vector<Picture>& allPics)
 
 Picture loadAtlasFromAniFiles(std::vector<const char*> pathes)
 {
-  AutoProfile ap("Atlas load+creation (ms)");
+  static const auto s_atlasLoad = registerStat("Atlas load+creation (ms)");
+  AutoProfile ap(s_atlasLoad);
   std::vector<Picture> allPics;
 
   for(auto path : pathes)
@@ -234,8 +238,11 @@ void tesselateSprites(int atlasTexture)
     bag->addQuad(s.pos - stamp.origin * scale, stamp.size * scale, s.color, stamp.uv0, stamp.uv1);
   }
 
-  Stat("Sprites", g_Sprites.size());
-  Stat("Bags for Sprites", bagCount);
+  static const auto s_sprites = registerStat("Sprites");
+  static const auto s_bags = registerStat("Bags for Sprites");
+
+  Stat(s_sprites, g_Sprites.size());
+  Stat(s_bags, bagCount);
 }
 
 Picture whitePicture()
@@ -265,9 +272,12 @@ void safeMain(Span<const String> args)
   uint8_t keys[256] {};
 
   bool quit = false;
+  bool showProfiler = false;
 
   while(!quit)
   {
+    profilerNewFrame();
+
     {
       SDL_Event event;
 
@@ -285,6 +295,20 @@ void safeMain(Span<const String> args)
 
             display_setFullscreen(fs);
           }
+
+          if(event.key.keysym.scancode == SDL_SCANCODE_F3 && !event.key.repeat)
+            showProfiler = !showProfiler;
+
+          if(event.key.keysym.scancode == SDL_SCANCODE_F9 && !event.key.repeat)
+          {
+            char path[256];
+            snprintf(path, sizeof path, "trace-%lld.json", (long long)time(nullptr));
+
+            if(dumpChromeTrace(path))
+              printf("Wrote profiler trace to '%s'\n", path);
+            else
+              printf("Can't write profiler trace to '%s'\n", path);
+          }
         }
       }
 
@@ -316,14 +340,19 @@ void safeMain(Span<const String> args)
     }
 
     {
-      AutoProfile aprof("App Tick Time (ms)");
+      static const auto s_appTick = registerStat("App Tick Time (ms)");
+      AutoProfile aprof(s_appTick);
 
       if(!AppTick(&gui, keys))
         quit = true;
     }
 
+    if(showProfiler)
+      drawProfilerOverlay(gui);
+
     {
-      AutoProfile aprof("Tesselation (ms)");
+      static const auto s_tesselation = registerStat("Tesselation (ms)");
+      AutoProfile aprof(s_tesselation);
 
       tesselateSprites(atlasTexture);
 
@@ -0,0 +1,84 @@
+#include "prediction.h"
+
+#include <algorithm> // min, max
+
+#include "clock.h"
+#include "gamelogic.h"
+#include "protocol.h" // GamePeriodMs
+#include "stats.h"
+
+namespace
+{
+// About three seconds of inputs: older ones are not replayed anymore
+const int MaxPending = 64;
+
+PlayerInputState g_inputs[MaxPending]; // by sequence number, modulo MaxPending
+uint32_t g_lastSeq = 0;
+
+GameLogicState g_state;
+int g_heroIndex = -1;
+bool g_fixedPoint = false; // movement math of the server
+BoardMasks<GameLogicState> g_boardMasks;
+
+Vec2f g_prevHeroPos; // before the last input
+int64_t g_lastInputDate = 0;
+
+void step(PlayerInputState input)
+{
+  if(g_heroIndex < 0)
+    return;
+
+  g_prevHeroPos = g_state.heroes[g_heroIndex].pos;
+
+  predictHeroMove(g_boardMasks, g_state, g_heroIndex, input, g_fixedPoint);
+}
+}
+
+void predictInput(uint32_t seq, PlayerInputState input)
+{
+  g_inputs[seq % MaxPending] = input;
+  g_lastSeq = seq;
+  g_lastInputDate = getMonotonicTimeNs();
+  step(input);
+}
+
+void reconcilePrediction(const GameLogicState& snapshot, int heroIndex, uint32_t inputSeq, bool fixedPoint)
+{
+  static const auto s_replayed = registerStat("Replayed Inputs");
+
+  g_state = snapshot;
+  g_fixedPoint = fixedPoint;
+  g_heroIndex = heroIndex >= 0 && heroIndex < GameLogicState::MAX_HEROES ? heroIndex : -1;
+
+  if(g_heroIndex >= 0)
+    g_prevHeroPos = g_state.heroes[g_heroIndex].pos;
+
+  const uint32_t oldest = g_lastSeq >= MaxPending ? g_lastSeq - MaxPending + 1 : 1;
+  int replayed = 0;
+
+  for(uint32_t seq = std::max(inputSeq + 1, oldest); seq <= g_lastSeq; ++seq)
+  {
+    step(g_inputs[seq % MaxPending]);
+    ++replayed;
+  }
+
+  Stat(s_replayed, replayed);
+}
+
+const GameLogicState& getPredictedState()
+{
+  return g_state;
+}
+
+int getPredictedHeroIndex()
+{
+  return g_heroIndex;
+}
+
+Vec2f getSmoothedHeroPos(int64_t now)
+{
+  const auto pos = g_state.heroes[std::max(g_heroIndex, 0)].pos;
+  const float alpha = std::min(1.0f, (now - g_lastInputDate) / (GamePeriodMs * 1000000.0f));
+
+  return g_prevHeroPos + (pos - g_prevHeroPos) * alpha;
+}
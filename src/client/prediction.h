@@ -0,0 +1,28 @@
+// Client-side prediction of the local hero.
+// Each input sent to the server is also applied right away, with the
+// movement code of the server (see predictHeroMove), on top of the last
+// snapshot. When a new snapshot arrives, the prediction restarts from it,
+// and replays the inputs the server hadn't applied yet: a misprediction
+// only lasts one round trip.
+#pragma once
+
+#include <stdint.h>
+
+#include "game.h"
+
+// 'input' has just been sent to the server, numbered 'seq'.
+void predictInput(uint32_t seq, PlayerInputState input);
+
+// 'heroIndex', 'inputSeq' and 'fixedPoint' come with the snapshot (see PacketStateHeader).
+void reconcilePrediction(const GameLogicState& snapshot, int heroIndex, uint32_t inputSeq, bool fixedPoint);
+
+// The last snapshot, with the local hero moved by the pending inputs.
+const GameLogicState& getPredictedState();
+
+// The local hero, or -1 if the server didn't tell yet.
+int getPredictedHeroIndex();
+
+// Where to draw the local hero at 'now' (see getMonotonicTimeNs): between its
+// positions before and after the last input, so it moves smoothly between
+// two game ticks, one tick behind the prediction.
+Vec2f getSmoothedHeroPos(int64_t now);
@@ -0,0 +1,250 @@
+#include "profiler.h"
+
+#include <algorithm> // max, min
+#include <cstdio>
+#include <vector>
+
+#include "clock.h"
+#include "steamgui_impl.h"
+
+namespace
+{
+const int FrameHistory = 300;
+
+struct ProfileEvent
+{
+  StatId stat;
+  int depth;
+  int64_t start; // relative to the start of the frame
+  int64_t duration; // -1 while the scope is open
+};
+
+struct ProfileFrame
+{
+  int64_t start = 0; // monotonic clock
+  int64_t duration = -1; // -1 while the frame is running
+  std::vector<ProfileEvent> events; // by increasing start date
+};
+
+// Ring buffer: the events vectors are reused, so the steady state doesn't allocate
+ProfileFrame g_frames[FrameHistory];
+int64_t g_frameCount = 0; // frames started so far: the last one is the current one
+int g_depth = 0;
+
+ProfileFrame& frameAt(int64_t frame)
+{
+  return g_frames[frame % FrameHistory];
+}
+
+// The finished frames still in the history: [first, g_frameCount - 1)
+int64_t firstFrame()
+{
+  return std::max<int64_t>(0, g_frameCount - FrameHistory);
+}
+
+// Layout of the overlay, in GUI units
+const Vec2f PanelPos = Vec2f(10, 290);
+const Vec2f PanelSize = Vec2f(620, 180);
+const float BarWidth = 2;
+const float BarMaxHeight = 50;
+const float BarMaxMs = 50; // frames longer than this are clipped
+const float RowHeight = 16;
+
+Vec4f frameColor(float ms)
+{
+  if(ms > 1000.0f / 30)
+    return Vec4f(0.9, 0.2, 0.2, 1);
+
+  if(ms > 1000.0f / 60)
+    return Vec4f(0.9, 0.6, 0.1, 1);
+
+  return Vec4f(0.2, 0.7, 0.2, 1);
+}
+
+// Stable per-name colors, so a scope is easy to follow from one frame to the next
+Vec4f scopeColor(StatId stat)
+{
+  const uint32_t h = uint32_t(stat.index + 1) * 2654435761u;
+  return Vec4f(0.3 + (h >> 24) / 512.0, 0.3 + ((h >> 16) & 0xff) / 512.0, 0.3 + ((h >> 8) & 0xff) / 512.0, 1);
+}
+
+void writeJsonString(FILE* fp, String s)
+{
+  fputc('"', fp);
+
+  for(auto c : s)
+  {
+    if(c == 0)
+      break; // string literals come with their terminator
+
+    if(c == '"' || c == '\\')
+      fputc('\\', fp);
+
+    fputc(c, fp);
+  }
+
+  fputc('"', fp);
+}
+}
+
+void profilerNewFrame()
+{
+  const int64_t now = getMonotonicTimeNs();
+
+  if(g_frameCount > 0)
+  {
+    auto& prev = frameAt(g_frameCount - 1);
+    prev.duration = now - prev.start;
+  }
+
+  auto& frame = frameAt(g_frameCount++);
+  frame.start = now;
+  frame.duration = -1;
+  frame.events.clear();
+  g_depth = 0;
+}
+
+AutoProfile::AutoProfile(StatId stat)
+  : m_stat(stat)
+  , m_timeStart(getMonotonicTimeNs())
+  , m_frame(g_frameCount - 1)
+  , m_event(-1)
+{
+  if(m_frame >= 0)
+  {
+    auto& frame = frameAt(m_frame);
+    m_event = (int)frame.events.size();
+    frame.events.push_back({ stat, g_depth, m_timeStart - frame.start, -1 });
+  }
+
+  ++g_depth;
+}
+
+AutoProfile::~AutoProfile()
+{
+  const int64_t duration = getMonotonicTimeNs() - m_timeStart;
+
+  g_depth = std::max(0, g_depth - 1);
+
+  // the frame might have changed under our feet
+  if(m_event >= 0 && m_frame == g_frameCount - 1)
+    frameAt(m_frame).events[m_event].duration = duration;
+
+  Stat(m_stat, duration / 1000000.0);
+}
+
+void drawProfilerOverlay(SteamGuiImpl& gui)
+{
+  const int64_t first = firstFrame();
+  const int64_t last = g_frameCount - 1; // excluded: still running
+
+  gui.drawRect(PanelPos, PanelSize, Vec4f(0, 0, 0, 0.7));
+
+  if(last <= first)
+    return;
+
+  // history, most recent on the right
+  const Vec2f barsOrigin = PanelPos + Vec2f(10, PanelSize.y - 5);
+  const float barsRight = barsOrigin.x + FrameHistory * BarWidth;
+  int64_t selected = -1;
+  int64_t slowest = first;
+
+  for(int64_t i = first; i < last; ++i)
+  {
+    const float x = barsRight - (last - i) * BarWidth;
+
+    if(gui.mousePos.x >= x && gui.mousePos.x < x + BarWidth && gui.mousePos.y >= barsOrigin.y - BarMaxHeight && gui.mousePos.y < barsOrigin.y)
+      selected = i;
+
+    if(frameAt(i).duration > frameAt(slowest).duration)
+      slowest = i;
+  }
+
+  if(selected < 0)
+    selected = slowest;
+
+  for(int64_t i = first; i < last; ++i)
+  {
+    const float ms = frameAt(i).duration / 1000000.0f;
+    const float height = std::min(ms, BarMaxMs) / BarMaxMs * BarMaxHeight;
+    const float x = barsRight - (last - i) * BarWidth;
+    const auto color = i == selected ? Vec4f(1, 1, 1, 1) : frameColor(ms);
+    gui.drawRect(Vec2f(x, barsOrigin.y - height), Vec2f(BarWidth, height), color);
+  }
+
+  // 60 fps budget
+  const float budgetY = barsOrigin.y - (1000.0f / 60) / BarMaxMs * BarMaxHeight;
+  gui.drawRect(Vec2f(barsOrigin.x, budgetY), Vec2f(FrameHistory * BarWidth, 1), Vec4f(1, 1, 1, 0.5));
+
+  // flame graph of the selected frame, across the whole panel
+  auto& frame = frameAt(selected);
+  const float frameMs = frame.duration / 1000000.0f;
+
+  char buf[256];
+  gui.drawText(PanelPos + Vec2f(10, 4), format(buf, "frame %lld: %.2f ms%s", (long long)selected, frameMs, selected == slowest ? " (slowest)" : ""));
+
+  const Vec2f graphOrigin = PanelPos + Vec2f(10, 24);
+  const float graphWidth = FrameHistory * BarWidth;
+  const float scale = frame.duration > 0 ? graphWidth / frame.duration : 0;
+
+  for(auto& event : frame.events)
+  {
+    if(event.duration < 0)
+      continue;
+
+    const auto pos = graphOrigin + Vec2f(event.start * scale, event.depth * RowHeight);
+    const auto size = Vec2f(std::max(1.0f, event.duration * scale), RowHeight - 1);
+
+    if(pos.y + size.y > barsOrigin.y - BarMaxHeight)
+      continue; // too deep
+
+    gui.drawRect(pos, size, scopeColor(event.stat));
+
+    // as many characters as fit
+    const auto name = getStatName(event.stat);
+    const int maxChars = std::min(name.len, int(size.x / 16));
+
+    if(maxChars > 0)
+      gui.drawText(pos, { name.data, maxChars });
+  }
+}
+
+bool dumpChromeTrace(const char* path)
+{
+  FILE* fp = fopen(path, "w");
+
+  if(!fp)
+    return false;
+
+  const int64_t first = firstFrame();
+  const int64_t last = g_frameCount - 1;
+  const int64_t origin = last > first ? frameAt(first).start : 0;
+
+  // durations in microseconds, one complete ("X") event per frame and per scope
+  auto writeEvent = [&] (String name, int64_t start, int64_t duration, bool isFirst)
+    {
+      fprintf(fp, "%s\n{\"name\":", isFirst ? "" : ",");
+      writeJsonString(fp, name);
+      fprintf(fp, ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}", (start - origin) / 1000.0, duration / 1000.0);
+    };
+
+  fprintf(fp, "{\"traceEvents\":[");
+
+  for(int64_t i = first; i < last; ++i)
+  {
+    auto& frame = frameAt(i);
+    writeEvent("Frame", frame.start, frame.duration, i == first);
+
+    for(auto& event : frame.events)
+    {
+      if(event.duration >= 0)
+        writeEvent(getStatName(event.stat), frame.start + event.start, event.duration, false);
+    }
+  }
+
+  fprintf(fp, "\n]}\n");
+
+  const bool failed = ferror(fp);
+  fclose(fp);
+  return !failed;
+}
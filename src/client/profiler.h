@@ -0,0 +1,35 @@
+// Hierarchical frame profiler.
+// AutoProfile scopes nest: each one is recorded into the current frame with
+// its depth, its start and its duration, and its duration is also published
+// as a Stat. The last frames are kept, so a hitch can be inspected after
+// the fact, in the overlay, or in a Chrome trace (chrome://tracing, Perfetto).
+#pragma once
+
+#include <stdint.h>
+
+#include "stats.h"
+
+struct SteamGuiImpl;
+
+// Ends the current frame, if any, and starts a new one.
+void profilerNewFrame();
+
+struct AutoProfile
+{
+  AutoProfile(StatId stat);
+  ~AutoProfile();
+
+private:
+  const StatId m_stat;
+  const int64_t m_timeStart;
+  int64_t m_frame; // the frame the scope was opened in
+  int m_event; // index in this frame, -1 if opened outside of any frame
+};
+
+// Draws the history of the frame durations, and the flame graph of one
+// frame: the one under the mouse, or else the slowest one.
+void drawProfilerOverlay(SteamGuiImpl& gui);
+
+// Writes the history in the Chrome trace event format.
+// Returns false if the file can't be written.
+bool dumpChromeTrace(const char* path);
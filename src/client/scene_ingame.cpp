@@ -1,7 +1,12 @@
 #include "scenes.h"
 
+#include "clock.h"
 #include "game.h"
+#include "interpolation.h"
+#include "prediction.h"
+#include "profiler.h"
 #include "protocol.h"
+#include "snapshots.h"
 #include "socket.h"
 #include "sprite.h"
 #include "stats.h"
@@ -14,6 +19,7 @@ extern std::vector<Sprite> g_Sprites;
 
 // from app.cpp
 extern Socket g_sock;
+extern uint32_t g_lastStateSeq;
 extern int GetTicks();
 
 namespace
@@ -67,7 +73,7 @@ void drawScene(const GameLogicState& state)
   }
 
   // draw players
-  static const Vec4f colors[MAX_HEROES] =
+  static const Vec4f colors[GameLogicState::MAX_HEROES] =
   {
     Vec4f(1, 1, 1, 1),
     Vec4f(1, 0, 0, 1),
@@ -107,11 +113,9 @@ void drawScene(const GameLogicState& state)
   }
 
   // draw bombs
-  for(auto& bomb : state.bombs)
+  for(int i = state.bombs.next(-1); i >= 0; i = state.bombs.next(i))
   {
-    if(!bomb.enable)
-      continue;
-
+    auto& bomb = state.bombs[i];
     auto& owner = state.heroes[bomb.ownerIndex];
 
     // draw flame
@@ -233,30 +237,79 @@ SceneFuncStruct gui(SteamGui* ui)
 SceneFuncStruct sceneIngame(SteamGui* ui)
 {
   static GameLogicState g_state;
+  static SnapshotDecoder<GameLogicState> g_decoder;
+  static int g_decoderRestarts = 0;
+
+  static const auto s_network = registerStat("Network (ms)");
+  static const auto s_scene = registerStat("Scene (ms)");
 
-  while(1)
   {
-    uint8_t buffer[2048];
-    Address unused;
-    int n = g_sock.recv(unused, buffer);
+    AutoProfile aprof(s_network);
 
-    if(n == 0)
-      break;
+    while(1)
+    {
+      uint8_t buffer[2048];
+      Address unused;
+      int n = g_sock.recv(unused, buffer);
 
-    lastReceivedPacketDate = GetTicks();
+      if(n == 0)
+        break;
 
-    if(buffer[0] == Op::State)
-    {
-      auto pkt = (PacketState*)buffer;
-      memcpy(&g_state, &pkt->state, sizeof g_state);
+      lastReceivedPacketDate = GetTicks();
+
+      if(buffer[0] == Op::State && n >= (int)sizeof(PacketStateHeader))
+      {
+        auto pkt = (PacketState*)buffer;
+
+        if(pkt->fragCount == 0)
+        {
+          // nothing new, but the server might have applied more of our inputs
+          if(pkt->instance == g_decoder.instance && pkt->seq == g_decoder.lastSeq)
+            reconcilePrediction(g_state, pkt->heroIndex, pkt->inputSeq, pkt->fixedPoint);
+        }
+        else if(g_decoder.receive(*pkt, n - (int)sizeof(PacketStateHeader), g_state) == DecodeResult::Decoded)
+        {
+          // the room started over: its ticks too
+          if(g_decoder.restarts != g_decoderRestarts)
+          {
+            g_decoderRestarts = g_decoder.restarts;
+            resetSnapshots();
+          }
+
+          pushSnapshot(g_state, pkt->seq, pkt->tick, getMonotonicTimeNs());
+          reconcilePrediction(g_state, pkt->heroIndex, pkt->inputSeq, pkt->fixedPoint);
+        }
+
+        g_lastStateSeq = g_decoder.lastSeq;
+      }
+      else
+      {
+        printf("Unknown Op: %d\n", buffer[0]);
+      }
     }
-    else
+  }
+
+  {
+    AutoProfile aprof(s_scene);
+
+    static GameLogicState drawn;
+    const int64_t now = getMonotonicTimeNs();
+
+    if(interpolateSnapshots(now, drawn))
     {
-      printf("Unknown Op: %d\n", buffer[0]);
+      // The local hero is predicted: it's drawn ahead of the rest of the state
+      const int hero = getPredictedHeroIndex();
+
+      if(hero >= 0)
+      {
+        drawn.heroes[hero] = getPredictedState().heroes[hero];
+        drawn.heroes[hero].pos = getSmoothedHeroPos(now);
+      }
     }
+
+    drawScene(drawn);
   }
 
-  drawScene(g_state);
   return gui(ui);
 }
 
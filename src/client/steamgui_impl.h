@@ -1,6 +1,8 @@
 #include "steamgui.h"
 #include "trianglebag.h"
 #include "vec.h"
+#include <cstdio> // sprintf
+#include <cstring> // strlen
 #include <vector>
 
 inline
@@ -162,6 +164,17 @@ struct SteamGuiImpl : SteamGui
     mouseButtonPrev = mouseButton;
   }
 
+  // free-form drawing, e.g for overlays
+  void drawRect(Vec2f pos, Vec2f size, Vec4f color)
+  {
+    getBag(whiteTexture).addQuad(pos, size, color);
+  }
+
+  void drawText(Vec2f pos, String text)
+  {
+    addText(pos, text);
+  }
+
   std::vector<TriangleBag> bags;
 
   TriangleBag & getBag(int texture)
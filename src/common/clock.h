@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+
+// Monotonic clock, in nanoseconds. The origin is unspecified.
+int64_t getMonotonicTimeNs();
+
+// Blocks until the monotonic clock reaches 'deadline'.
+// Returns immediately if the deadline is already in the past.
+void sleepUntil(int64_t deadline);
@@ -0,0 +1,23 @@
+#include "clock.h"
+
+#include <errno.h>
+#include <time.h>
+
+int64_t getMonotonicTimeNs()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+void sleepUntil(int64_t deadline)
+{
+  timespec ts;
+  ts.tv_sec = deadline / 1000000000ll;
+  ts.tv_nsec = deadline % 1000000000ll;
+
+  // absolute deadline: being interrupted doesn't shift the wake-up date
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+  {
+  }
+}
@@ -0,0 +1,16 @@
+#include "clock.h"
+
+#include <chrono>
+#include <thread>
+
+int64_t getMonotonicTimeNs()
+{
+  const auto now = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+}
+
+void sleepUntil(int64_t deadline)
+{
+  const auto date = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(deadline));
+  std::this_thread::sleep_until(date);
+}
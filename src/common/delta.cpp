@@ -0,0 +1,139 @@
+#include "delta.h"
+
+namespace
+{
+struct Writer
+{
+  Span<uint8_t> out;
+  int pos = 0;
+  bool overflow = false;
+
+  void byte(uint8_t val)
+  {
+    if(pos >= out.len)
+    {
+      overflow = true;
+      return;
+    }
+
+    out[pos++] = val;
+  }
+
+  void varint(int val)
+  {
+    while(val >= 0x80)
+    {
+      byte(uint8_t(val | 0x80));
+      val >>= 7;
+    }
+
+    byte(uint8_t(val));
+  }
+};
+
+struct Reader
+{
+  Span<const uint8_t> in;
+  int pos = 0;
+  bool error = false;
+
+  uint8_t byte()
+  {
+    if(pos >= in.len)
+    {
+      error = true;
+      return 0;
+    }
+
+    return in[pos++];
+  }
+
+  int varint()
+  {
+    int val = 0;
+
+    for(int shift = 0; shift < 28; shift += 7)
+    {
+      const uint8_t b = byte();
+      val |= (b & 0x7f) << shift;
+
+      if(!(b & 0x80))
+        return val;
+    }
+
+    error = true;
+    return 0;
+  }
+};
+
+uint8_t baseByte(Span<const uint8_t> base, int i)
+{
+  return i < base.len ? base[i] : 0;
+}
+}
+
+int encodeDelta(Span<const uint8_t> base, Span<const uint8_t> curr, Span<uint8_t> out)
+{
+  Writer w { out };
+
+  auto diff = [&] (int i) { return uint8_t(curr[i] ^ baseByte(base, i)); };
+
+  w.varint(curr.len);
+
+  int i = 0;
+
+  while(i < curr.len)
+  {
+    const int zeroStart = i;
+
+    while(i < curr.len && diff(i) == 0)
+      ++i;
+
+    const int litStart = i;
+
+    // a single unchanged byte is cheaper to send as a literal than to
+    // start a new run for it
+    while(i < curr.len && (diff(i) || (i + 1 < curr.len && diff(i + 1))))
+      ++i;
+
+    w.varint(litStart - zeroStart);
+    w.varint(i - litStart);
+
+    for(int k = litStart; k < i; ++k)
+      w.byte(diff(k));
+  }
+
+  return w.overflow ? -1 : w.pos;
+}
+
+int decodeDelta(Span<const uint8_t> base, Span<const uint8_t> delta, Span<uint8_t> out)
+{
+  Reader r { delta };
+
+  const int len = r.varint();
+
+  if(r.error || len > out.len)
+    return -1;
+
+  int i = 0;
+
+  while(i < len)
+  {
+    const int zeroCount = r.varint();
+    const int litCount = r.varint();
+
+    if(r.error || zeroCount + litCount == 0 || zeroCount + litCount > len - i)
+      return -1;
+
+    for(int k = 0; k < zeroCount; ++k, ++i)
+      out[i] = baseByte(base, i);
+
+    for(int k = 0; k < litCount; ++k, ++i)
+      out[i] = baseByte(base, i) ^ r.byte();
+
+    if(r.error)
+      return -1;
+  }
+
+  return len;
+}
@@ -0,0 +1,18 @@
+// Delta-encoding of byte buffers.
+// The new buffer is XOR'ed with the baseline, and the result is stored as a
+// sequence of (zero run, literal run) pairs, so unchanged bytes cost almost
+// nothing.
+// The buffers don't need to have the same size: the baseline is considered
+// zero-padded.
+#pragma once
+
+#include <stdint.h>
+
+#include "span.h"
+
+// Returns the size of the encoded delta, or -1 if it doesn't fit in 'out'.
+int encodeDelta(Span<const uint8_t> base, Span<const uint8_t> curr, Span<uint8_t> out);
+
+// Returns the size of the decoded buffer, or -1 if 'delta' is malformed
+// or if the result doesn't fit in 'out'.
+int decodeDelta(Span<const uint8_t> base, Span<const uint8_t> delta, Span<uint8_t> out);
@@ -0,0 +1,59 @@
+#include "game.h"
+
+#include <cstring> // strcmp
+
+namespace
+{
+const char* const presetNames[] =
+{
+  "classic",
+  "31x21",
+  "63x63",
+};
+
+static_assert(sizeof(presetNames) / sizeof(*presetNames) == (int)MapPreset::Count);
+}
+
+uint8_t packInput(PlayerInputState input)
+{
+  return input.left << 0
+         | input.right << 1
+         | input.up << 2
+         | input.down << 3
+         | input.dropBomb << 4
+         | input.action << 5;
+}
+
+PlayerInputState unpackInput(uint8_t bits)
+{
+  PlayerInputState r;
+  r.left = bits & (1 << 0);
+  r.right = bits & (1 << 1);
+  r.up = bits & (1 << 2);
+  r.down = bits & (1 << 3);
+  r.dropBomb = bits & (1 << 4);
+  r.action = bits & (1 << 5);
+  return r;
+}
+
+bool parseMapPreset(const char* name, MapPreset& preset)
+{
+  for(int i = 0; i < (int)MapPreset::Count; ++i)
+  {
+    if(strcmp(name, presetNames[i]) == 0)
+    {
+      preset = (MapPreset)i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+const char* mapPresetName(MapPreset preset)
+{
+  if((int)preset >= (int)MapPreset::Count)
+    return "unknown";
+
+  return presetNames[(int)preset];
+}
@@ -7,8 +7,6 @@
 #include "address.h"
 #include "vec.h"
 
-static const int MAX_HEROES = 8;
-
 struct PlayerInputState
 {
   bool left, right, up, down;
@@ -16,6 +14,13 @@ struct PlayerInputState
   bool action; // boxing-glove, detonate, etc.
 };
 
+// One bit per field, in the low 'PackedInputBits' bits.
+// Used by the network protocol and by the demo files.
+const int PackedInputBits = 6;
+
+uint8_t packInput(PlayerInputState input);
+PlayerInputState unpackInput(uint8_t bits);
+
 struct GameSession
 {
   struct Player
@@ -24,6 +29,8 @@ struct GameSession
     int heroIndex;
     int watchdog;
     Address address;
+    uint32_t joinSeq; // last snapshot sent before this player joined
+    uint32_t ackSeq; // last snapshot received by this player
   };
 
   std::vector<Player> players;
@@ -57,39 +64,160 @@ enum
   UPGRADE_GLOVE = 16,
 };
 
-// The gamestate, as seen by the server.
-// This whole struct should fit in one UDP packet.
-struct GameLogicState
+struct HeroState
 {
-  static constexpr int COLS = 15;
-  static constexpr int ROWS = 11;
+  Vec2f pos;
+  uint16_t upgrades;
+  uint8_t flamelength : 4;
+  uint8_t walkspeed : 4;
+  uint8_t maxbombs : 4;
+  uint8_t orientation : 4; // left, up, right, down
+  bool dead : 1;
+  bool enable : 1;
+  bool isHoldingBomb : 1;
+};
+
+struct BombState
+{
+  Vec2f pos;
+  Vec2f vel; // kick, jelly-bomb
+  int8_t countdown; // explodes at 10, removed at 0
+  int8_t ownerIndex; // hero index, used to fetch properties
+  bool jelly;
+};
+
+// Fixed-capacity bomb storage.
+// The live slots are tracked in a bitmap: allocating (lowest free slot)
+// and iterating (by increasing slot) cost one bit scan per 64 slots.
+// A zero-initialized pool is empty.
+template<int Capacity_>
+struct BasicBombPool
+{
+  static constexpr int Capacity = Capacity_;
+  static constexpr int Words = (Capacity + 63) / 64;
+
+  BombState slots[Capacity];
+  uint64_t live[Words];
 
-  struct Hero
+  BombState& operator [] (int i) { return slots[i]; }
+  const BombState& operator [] (int i) const { return slots[i]; }
+
+  bool isLive(int i) const { return (live[i / 64] >> (i % 64)) & 1; }
+
+  int count() const
   {
-    Vec2f pos;
-    uint16_t upgrades;
-    uint8_t flamelength : 4;
-    uint8_t walkspeed : 4;
-    uint8_t maxbombs : 4;
-    uint8_t orientation : 4; // left, up, right, down
-    bool dead : 1;
-    bool enable : 1;
-    bool isHoldingBomb : 1;
-  };
+    int r = 0;
+
+    for(auto word : live)
+      r += __builtin_popcountll(word);
+
+    return r;
+  }
 
-  struct Bomb
+  // Returns the first live slot after 'i', or -1.
+  // Pass -1 to get the first one.
+  int next(int i) const
   {
-    Vec2f pos;
-    Vec2f vel; // kick, jelly-bomb
-    int8_t countdown; // explodes at 10, removed at 0
-    int8_t ownerIndex; // hero index, used to fetch properties
-    bool jelly;
-    bool enable;
-  };
+    for(int w = (i + 1) / 64; w < Words; ++w)
+    {
+      uint64_t word = live[w];
+
+      if(w == (i + 1) / 64)
+        word &= ~0ull << ((i + 1) % 64);
+
+      if(word)
+        return w * 64 + __builtin_ctzll(word);
+    }
+
+    return -1;
+  }
+
+  // Returns a cleared slot, or -1 if the pool is full.
+  int alloc()
+  {
+    for(int w = 0; w < Words; ++w)
+    {
+      if(~live[w])
+      {
+        const int i = w * 64 + __builtin_ctzll(~live[w]);
+
+        if(i >= Capacity)
+          break;
+
+        live[w] |= 1ull << (i % 64);
+        slots[i] = {};
+        return i;
+      }
+    }
+
+    return -1;
+  }
+
+  void free(int i) { live[i / 64] &= ~(1ull << (i % 64)); }
+};
+
+// Map sizes and player counts. Each room picks one when it's created.
+enum class MapPreset : uint8_t
+{
+  Classic, // 15x11, 8 heroes
+  Map31x21, // 16 heroes
+  Map63x63, // 32 heroes
+  Count,
+};
+
+// The gamestate, as seen by the server.
+// Everything is sized at compile time, so each preset gets its own
+// specialized simulation code.
+// The wire encoding of the classic preset fits in one UDP packet;
+// the bigger ones are fragmented (see protocol.h).
+template<int Cols, int Rows, int MaxHeroes, MapPreset Preset>
+struct BasicGameLogicState
+{
+  static constexpr MapPreset PRESET = Preset;
+  static constexpr int COLS = Cols;
+  static constexpr int ROWS = Rows;
+  static constexpr int MAX_HEROES = MaxHeroes;
+
+  // Enough for every hero to hold the maximum number of bombs at once.
+  static constexpr int MAX_BOMBS = MaxHeroes * 16;
+
+  using Hero = HeroState;
+  using Bomb = BombState;
+  using BombPool = BasicBombPool<MAX_BOMBS>;
 
   uint8_t board[ROWS][COLS];
   uint8_t items[ROWS][COLS];
   Hero heroes[MAX_HEROES];
-  Bomb bombs[16];
+  BombPool bombs;
+};
+
+using GameLogicState = BasicGameLogicState<15, 11, 8, MapPreset::Classic>;
+using GameLogicState31x21 = BasicGameLogicState<31, 21, 16, MapPreset::Map31x21>;
+using GameLogicState63x63 = BasicGameLogicState<63, 63, 32, MapPreset::Map63x63>;
+
+template<typename T>
+struct TypeTag
+{
+  using type = T;
 };
 
+// Calls 'f' with the TypeTag of the state type of 'preset'.
+template<typename Visitor>
+void visitPreset(MapPreset preset, Visitor&& f)
+{
+  switch(preset)
+  {
+  case MapPreset::Classic: f(TypeTag<GameLogicState>{});
+    break;
+  case MapPreset::Map31x21: f(TypeTag<GameLogicState31x21>{});
+    break;
+  case MapPreset::Map63x63: f(TypeTag<GameLogicState63x63>{});
+    break;
+  case MapPreset::Count:
+    break;
+  }
+}
+
+// "classic", "31x21" or "63x63". Returns false for an unknown name.
+bool parseMapPreset(const char* name, MapPreset& preset);
+const char* mapPresetName(MapPreset preset);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "span.h"
+
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+public:
+  MappedFile(const char* path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator = (const MappedFile&) = delete;
+
+  Span<const uint8_t> data() const { return { m_data, m_size }; }
+
+private:
+  const uint8_t* m_data = nullptr;
+  int m_size = 0;
+  intptr_t m_handle = 0;
+};
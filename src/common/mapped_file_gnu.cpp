@@ -0,0 +1,49 @@
+#include "mapped_file.h"
+
+#include <fcntl.h> // open
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <unistd.h> // close
+
+#include <stdexcept>
+#include <string>
+
+MappedFile::MappedFile(const char* path)
+{
+  const int fd = open(path, O_RDONLY);
+
+  if(fd < 0)
+    throw std::runtime_error("Could not open '" + std::string(path) + "'");
+
+  struct stat st;
+
+  if(fstat(fd, &st) < 0)
+  {
+    close(fd);
+    throw std::runtime_error("Could not stat '" + std::string(path) + "'");
+  }
+
+  m_size = (int)st.st_size;
+
+  if(m_size > 0)
+  {
+    void* p = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if(p == MAP_FAILED)
+    {
+      close(fd);
+      throw std::runtime_error("Could not map '" + std::string(path) + "'");
+    }
+
+    m_data = (const uint8_t*)p;
+  }
+
+  // the mapping stays valid after the descriptor is closed
+  close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  if(m_data)
+    munmap((void*)m_data, m_size);
+}
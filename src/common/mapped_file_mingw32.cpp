@@ -0,0 +1,41 @@
+#include "mapped_file.h"
+
+#include <windows.h>
+
+#include <stdexcept>
+#include <string>
+
+MappedFile::MappedFile(const char* path)
+{
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+  if(file == INVALID_HANDLE_VALUE)
+    throw std::runtime_error("Could not open '" + std::string(path) + "'");
+
+  m_size = (int)GetFileSize(file, nullptr);
+
+  if(m_size > 0)
+  {
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if(!mapping)
+    {
+      CloseHandle(file);
+      throw std::runtime_error("Could not map '" + std::string(path) + "'");
+    }
+
+    m_data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    m_handle = (intptr_t)mapping;
+  }
+
+  CloseHandle(file);
+}
+
+MappedFile::~MappedFile()
+{
+  if(m_data)
+    UnmapViewOfFile(m_data);
+
+  if(m_handle)
+    CloseHandle((HANDLE)m_handle);
+}
@@ -6,8 +6,9 @@
 static const int ServerUdpPort = 0xACE1;
 static const auto GamePeriodMs = 50;
 static const int MTU = 1472;
+static const int MaxRooms = 512;
 
-enum Op
+enum Op : uint8_t
 {
   // client-to-server messages
   KeepAlive,
@@ -17,30 +18,82 @@ enum Op
 
   // server-to-client messages
   State,
+
+  // monitoring, only answered to the local host
+  QueryMetrics, // request
+  Metrics, // reply
 };
 
 struct PacketHeader
 {
   Op op;
+  uint16_t roomId; // the match this packet belongs to
 };
 
 struct PacketKeepAlive
 {
   PacketHeader hdr;
+  MapPreset preset; // of the room, if it doesn't exist yet. Optional: defaults to Classic
 };
 static_assert(sizeof(PacketKeepAlive) < MTU);
 
-struct PacketState
+struct PacketDisconnect
+{
+  PacketHeader hdr;
+};
+static_assert(sizeof(PacketDisconnect) < MTU);
+
+// Snapshots are numbered by the server, starting from 1.
+// Clients acknowledge the last snapshot they have decoded, and the server
+// sends the following ones as deltas against it (see delta.h).
+// Snapshots are serialized using serialization.h.
+// A (delta-encoded) snapshot that doesn't fit in one datagram is split into
+// several fragments, of the maximum payload size except the last one.
+// The server only sends a new snapshot when the state changed. Meanwhile,
+// the players that have the current one get a heartbeat every tick: a header
+// without fragments (fragCount is zero), with the current 'seq'.
+// 'heroIndex' and 'inputSeq' are specific to the recipient: they let the
+// client replay the inputs the snapshot doesn't include yet, with the
+// movement math of the room ('fixedPoint').
+// 'instance' changes when the room starts over (server restart, room
+// recreated): the snapshot numbers start from 1 again.
+struct PacketStateHeader
 {
   PacketHeader hdr;
-  GameLogicState state;
+  uint32_t instance; // random, never zero
+  uint32_t seq;
+  uint32_t baseSeq; // zero for a keyframe
+  uint8_t fragIndex;
+  uint8_t fragCount; // at most MaxFragments, zero for a heartbeat
+  int8_t heroIndex; // the hero played by the recipient
+  uint32_t inputSeq; // last input of the recipient applied to the snapshot
+  bool fixedPoint; // the room simulates movement in fixed point (see BasicGameMatch)
+  uint32_t tick; // number of ticks simulated by the room, when the snapshot was taken
+  uint64_t stateHash; // hashState() of the snapshot, to detect desyncs (see state_hash.h)
 };
-static_assert(sizeof(PacketState) < MTU);
 
+struct PacketState : PacketStateHeader
+{
+  // The datagram is truncated to the actual payload size.
+  uint8_t payload[MTU - sizeof(PacketStateHeader)];
+};
+static_assert(sizeof(PacketState) <= MTU);
+
+static const int MaxFragments = 32;
+static const int FragmentSize = sizeof(PacketState::payload);
+
+static const int MaxInputHistory = 8;
+
+// Sent once per game tick. Inputs are numbered by the client, starting from 1.
+// Each packet repeats the last inputs, so the ones of a lost packet still
+// reach the server, which applies each input exactly once, one per tick.
 struct PacketPlayerInput
 {
   PacketHeader hdr;
-  PlayerInputState input;
+  uint32_t inputSeq; // of inputs[0]
+  uint32_t ackSeq; // last snapshot successfully decoded
+  uint8_t inputCount; // at most MaxInputHistory
+  uint8_t inputs[MaxInputHistory]; // see packInput(). inputs[i] is the input 'inputSeq - i'
 };
 static_assert(sizeof(PacketPlayerInput) < MTU);
 
@@ -50,3 +103,25 @@ struct PacketRestart
 };
 static_assert(sizeof(PacketRestart) < MTU);
 
+struct PacketQueryMetrics
+{
+  PacketHeader hdr; // roomId is ignored
+};
+static_assert(sizeof(PacketQueryMetrics) < MTU);
+
+// The reply is split over several datagrams, at line boundaries.
+static const int MaxMetricsParts = 32;
+
+struct PacketMetrics
+{
+  PacketHeader hdr;
+  uint8_t part; // index of this datagram in the reply
+  uint8_t partCount;
+  bool truncated; // the text didn't fit in MaxMetricsParts datagrams: the last lines were dropped
+
+  // A slice of the metrics, in the same text format as the exported file.
+  // The datagram is truncated to the actual text size.
+  char text[MTU - sizeof(PacketHeader) - 3];
+};
+static_assert(sizeof(PacketMetrics) <= MTU);
+
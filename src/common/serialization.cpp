@@ -0,0 +1,348 @@
+#include "serialization.h"
+
+#include <cmath>
+#include <cstddef> // offsetof
+#include <cstring> // memcpy
+
+namespace
+{
+// Positions are sent as signed fixed-point numbers, in 1/256th of a cell.
+const int PosFracBits = 8;
+const int VelBits = 9;
+
+const int BoardBits = 2;
+const int ItemBits = 4;
+const int UpgradeBits = 5;
+const int CountdownBits = 7;
+
+static_assert(MAX_ITEM <= (1 << ItemBits));
+static_assert(UPGRADE_GLOVE < (1 << UpgradeBits));
+
+// Number of bits needed to store the values from 0 to 'n'.
+constexpr int bitsFor(int n)
+{
+  return n > 0 ? 1 + bitsFor(n / 2) : 0;
+}
+
+// The widths of the fields that depend on the map and player counts.
+template<typename State>
+struct Widths
+{
+  // sign bit, and one bit of margin
+  static constexpr int Pos = 2 + bitsFor(State::COLS > State::ROWS ? State::COLS : State::ROWS) + PosFracBits;
+  static constexpr int HeroIndex = bitsFor(State::MAX_HEROES - 1);
+  static constexpr int BombCount = bitsFor(State::MAX_BOMBS);
+  static constexpr int BombIndex = bitsFor(State::MAX_BOMBS - 1);
+
+  static constexpr int HeroBits = 2 * Pos + UpgradeBits + 4 + 4 + 4 + 2 + 1 + 1;
+  static constexpr int BombBits = BombIndex + 2 * Pos + 2 * VelBits + CountdownBits + HeroIndex + 1;
+
+  static constexpr int MaxCompactBits =
+    State::ROWS * State::COLS * (BoardBits + ItemBits)
+    + State::MAX_HEROES * (1 + HeroBits)
+    + BombCount + State::MAX_BOMBS * BombBits;
+};
+
+static_assert(Widths<GameLogicState>::Pos == 14);
+static_assert(Widths<GameLogicState>::HeroIndex == 3);
+static_assert(Widths<GameLogicState>::BombIndex == 7);
+
+struct BitWriter
+{
+  Span<uint8_t> out;
+  int bitPos = 0;
+  bool overflow = false;
+
+  void write(uint32_t val, int bits)
+  {
+    for(int i = 0; i < bits; ++i)
+    {
+      const int byteIdx = bitPos / 8;
+
+      if(byteIdx >= out.len)
+      {
+        overflow = true;
+        return;
+      }
+
+      if(bitPos % 8 == 0)
+        out[byteIdx] = 0;
+
+      if(val & (1u << i))
+        out[byteIdx] |= 1 << (bitPos % 8);
+
+      ++bitPos;
+    }
+  }
+
+  void writeSigned(int val, int bits)
+  {
+    write(uint32_t(val) & ((1u << bits) - 1), bits);
+  }
+
+  void writeFixed(float val, int bits)
+  {
+    writeSigned((int)::round(val * (1 << PosFracBits)), bits);
+  }
+
+  int size() const { return (bitPos + 7) / 8; }
+};
+
+struct BitReader
+{
+  Span<const uint8_t> in;
+  int bitPos = 0;
+  bool error = false;
+
+  uint32_t read(int bits)
+  {
+    uint32_t val = 0;
+
+    for(int i = 0; i < bits; ++i)
+    {
+      const int byteIdx = bitPos / 8;
+
+      if(byteIdx >= in.len)
+      {
+        error = true;
+        return 0;
+      }
+
+      if(in[byteIdx] & (1 << (bitPos % 8)))
+        val |= 1u << i;
+
+      ++bitPos;
+    }
+
+    return val;
+  }
+
+  int readSigned(int bits)
+  {
+    const uint32_t val = read(bits);
+    const uint32_t signBit = 1u << (bits - 1);
+    return int(val ^ signBit) - int(signBit);
+  }
+
+  float readFixed(int bits)
+  {
+    return readSigned(bits) / float(1 << PosFracBits);
+  }
+};
+
+// Raw encoding: everything before the bomb pool as is,
+// then the live bitmap, then the live bombs.
+template<typename State>
+int rawSize(int bombCount)
+{
+  return offsetof(State, bombs) + sizeof(State::bombs.live) + bombCount * sizeof(BombState);
+}
+
+template<typename State>
+void writeCompact(BitWriter& w, const State& state)
+{
+  using W = Widths<State>;
+
+  for(auto& row : state.board)
+    for(auto cell : row)
+      w.write(cell, BoardBits);
+
+  for(auto& row : state.items)
+    for(auto item : row)
+      w.write(item, ItemBits);
+
+  for(auto& h : state.heroes)
+    w.write(h.enable, 1);
+
+  for(auto& h : state.heroes)
+  {
+    if(!h.enable)
+      continue;
+
+    w.writeFixed(h.pos.x, W::Pos);
+    w.writeFixed(h.pos.y, W::Pos);
+    w.write(h.upgrades, UpgradeBits);
+    w.write(h.flamelength, 4);
+    w.write(h.walkspeed, 4);
+    w.write(h.maxbombs, 4);
+    w.write(h.orientation, 2);
+    w.write(h.dead, 1);
+    w.write(h.isHoldingBomb, 1);
+  }
+
+  w.write(state.bombs.count(), W::BombCount);
+
+  for(int i = state.bombs.next(-1); i >= 0; i = state.bombs.next(i))
+  {
+    auto& b = state.bombs[i];
+    w.write(i, W::BombIndex);
+    w.writeFixed(b.pos.x, W::Pos);
+    w.writeFixed(b.pos.y, W::Pos);
+    w.writeFixed(b.vel.x, VelBits);
+    w.writeFixed(b.vel.y, VelBits);
+    w.write(b.countdown, CountdownBits);
+    w.write(b.ownerIndex, W::HeroIndex);
+    w.write(b.jelly, 1);
+  }
+}
+
+template<typename State>
+void readCompact(BitReader& r, State& state)
+{
+  using W = Widths<State>;
+
+  for(auto& row : state.board)
+    for(auto& cell : row)
+      cell = r.read(BoardBits);
+
+  for(auto& row : state.items)
+    for(auto& item : row)
+      item = r.read(ItemBits);
+
+  for(auto& h : state.heroes)
+    h.enable = r.read(1);
+
+  for(auto& h : state.heroes)
+  {
+    if(!h.enable)
+      continue;
+
+    h.pos.x = r.readFixed(W::Pos);
+    h.pos.y = r.readFixed(W::Pos);
+    h.upgrades = r.read(UpgradeBits);
+    h.flamelength = r.read(4);
+    h.walkspeed = r.read(4);
+    h.maxbombs = r.read(4);
+    h.orientation = r.read(2);
+    h.dead = r.read(1);
+    h.isHoldingBomb = r.read(1);
+  }
+
+  const int bombCount = r.read(W::BombCount);
+
+  for(int i = 0; i < bombCount && !r.error; ++i)
+  {
+    const int idx = r.read(W::BombIndex);
+
+    if(idx >= State::MAX_BOMBS)
+    {
+      r.error = true;
+      break;
+    }
+
+    auto& b = state.bombs[idx];
+    state.bombs.live[idx / 64] |= 1ull << (idx % 64);
+    b.pos.x = r.readFixed(W::Pos);
+    b.pos.y = r.readFixed(W::Pos);
+    b.vel.x = r.readFixed(VelBits);
+    b.vel.y = r.readFixed(VelBits);
+    b.countdown = r.read(CountdownBits);
+    b.ownerIndex = r.read(W::HeroIndex);
+    b.jelly = r.read(1);
+  }
+}
+}
+
+template<typename State>
+int serializeState(const State& state, Span<uint8_t> out, StateEncoding encoding)
+{
+  static_assert(2 + (Widths<State>::MaxCompactBits + 7) / 8 <= maxSerializedSize<State>());
+
+  if(out.len < 2)
+    return -1;
+
+  out[0] = (uint8_t)encoding;
+  out[1] = (uint8_t)State::PRESET;
+  out += 2;
+
+  switch(encoding)
+  {
+  case StateEncoding::Compact:
+    {
+      BitWriter w { out };
+      writeCompact(w, state);
+      return w.overflow ? -1 : 2 + w.size();
+    }
+  case StateEncoding::Raw:
+    {
+      const int size = rawSize<State>(state.bombs.count());
+
+      if(out.len < size)
+        return -1;
+
+      auto p = out.data;
+      memcpy(p, &state, offsetof(State, bombs));
+      p += offsetof(State, bombs);
+      memcpy(p, state.bombs.live, sizeof state.bombs.live);
+      p += sizeof state.bombs.live;
+
+      for(int i = state.bombs.next(-1); i >= 0; i = state.bombs.next(i))
+      {
+        memcpy(p, &state.bombs[i], sizeof(BombState));
+        p += sizeof(BombState);
+      }
+
+      return 2 + size;
+    }
+  }
+
+  return -1;
+}
+
+template<typename State>
+bool deserializeState(Span<const uint8_t> in, State& state)
+{
+  if(in.len < 2)
+    return false;
+
+  const auto encoding = (StateEncoding)in[0];
+
+  if(in[1] != (uint8_t)State::PRESET)
+    return false;
+
+  in += 2;
+
+  switch(encoding)
+  {
+  case StateEncoding::Compact:
+    {
+      BitReader r { in };
+      state = {};
+      readCompact(r, state);
+      return !r.error;
+    }
+  case StateEncoding::Raw:
+    {
+      if(in.len < rawSize<State>(0))
+        return false;
+
+      state = {};
+      auto p = in.data;
+      memcpy(&state, p, offsetof(State, bombs));
+      p += offsetof(State, bombs);
+      memcpy(state.bombs.live, p, sizeof state.bombs.live);
+      p += sizeof state.bombs.live;
+
+      if(in.len != rawSize<State>(state.bombs.count()))
+        return false;
+
+      for(int i = state.bombs.next(-1); i >= 0; i = state.bombs.next(i))
+      {
+        memcpy(&state.bombs[i], p, sizeof(BombState));
+        p += sizeof(BombState);
+      }
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+template int serializeState(const GameLogicState&, Span<uint8_t>, StateEncoding);
+template int serializeState(const GameLogicState31x21&, Span<uint8_t>, StateEncoding);
+template int serializeState(const GameLogicState63x63&, Span<uint8_t>, StateEncoding);
+
+template bool deserializeState(Span<const uint8_t>, GameLogicState&);
+template bool deserializeState(Span<const uint8_t>, GameLogicState31x21&);
+template bool deserializeState(Span<const uint8_t>, GameLogicState63x63&);
@@ -0,0 +1,37 @@
+// Wire encoding of the game states.
+// The first two bytes are the encoding and the MapPreset.
+#pragma once
+
+#include <stdint.h>
+
+#include "game.h"
+#include "span.h"
+
+enum class StateEncoding : uint8_t
+{
+  // Bit-packed: 2 bits per board cell, 4 bits per item, fixed-point
+  // positions, and only the enabled heroes and the live bombs.
+  Compact,
+
+  // Raw copy of the struct, skipping the free bomb slots.
+  // Only meant for debugging: it doesn't fit in a packet once there are many bombs.
+  Raw,
+};
+
+// Upper bound of the size of a serialized 'State', whatever the encoding.
+// The raw encoding is the biggest one, and never exceeds the struct itself.
+template<typename State>
+constexpr int maxSerializedSize()
+{
+  return 2 + sizeof(State);
+}
+
+// Returns the number of bytes written, or -1 if it doesn't fit in 'out'.
+// Instantiated for each MapPreset.
+template<typename State>
+int serializeState(const State& state, Span<uint8_t> out, StateEncoding encoding);
+
+// Returns false if 'in' is malformed, or encodes another MapPreset.
+// The encoding is auto-detected.
+template<typename State>
+bool deserializeState(Span<const uint8_t> in, State& state);
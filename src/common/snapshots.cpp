@@ -0,0 +1,124 @@
+#include "snapshots.h"
+
+#include <cstring> // memcpy
+
+#include "delta.h"
+#include "state_hash.h"
+
+template<typename State>
+DecodeResult SnapshotDecoder<State>::receive(const PacketState& pkt, int payloadSize, State& state)
+{
+  if(pkt.fragCount < 1 || pkt.fragCount > MaxFragments || pkt.fragIndex >= pkt.fragCount)
+    return DecodeResult::Rejected;
+
+  if(payloadSize < 0 || payloadSize > (int)sizeof pkt.payload)
+    return DecodeResult::Rejected;
+
+  // all the fragments but the last one are full
+  const bool isLast = pkt.fragIndex + 1 == pkt.fragCount;
+
+  if(!isLast && payloadSize != FragmentSize)
+    return DecodeResult::Rejected;
+
+  // the room started over, and numbers its snapshots from 1 again
+  if(pkt.instance != instance)
+  {
+    if(instance != 0)
+      reset();
+
+    instance = pkt.instance;
+  }
+
+  if(pkt.seq <= lastSeq)
+    return DecodeResult::Rejected; // late or duplicated
+
+  Span<const uint8_t> payload { pkt.payload, payloadSize };
+
+  if(pkt.fragCount > 1)
+  {
+    auto& r = m_pending;
+
+    if(pkt.seq < r.seq)
+      return DecodeResult::Rejected; // we've already started receiving a newer one
+
+    if(pkt.seq != r.seq)
+    {
+      r.seq = pkt.seq;
+      r.baseSeq = pkt.baseSeq;
+      r.fragCount = pkt.fragCount;
+      r.receivedMask = 0;
+      r.size = 0;
+    }
+
+    const int offset = pkt.fragIndex * FragmentSize;
+
+    if(pkt.baseSeq != r.baseSeq || pkt.fragCount != r.fragCount || offset + payloadSize > (int)sizeof r.data)
+      return DecodeResult::Rejected;
+
+    memcpy(r.data + offset, pkt.payload, payloadSize);
+    r.receivedMask |= 1u << pkt.fragIndex;
+
+    if(isLast)
+      r.size = offset + payloadSize;
+
+    const uint32_t allReceived = uint32_t((1ull << r.fragCount) - 1);
+
+    if(r.receivedMask != allReceived)
+      return DecodeResult::Pending;
+
+    payload = { r.data, r.size };
+  }
+
+  Snapshot decoded;
+  decoded.seq = pkt.seq;
+
+  if(pkt.baseSeq == 0)
+  {
+    if(payload.len > (int)sizeof decoded.data)
+      return DecodeResult::Rejected;
+
+    decoded.size = payload.len;
+    memcpy(decoded.data, payload.data, payload.len);
+  }
+  else
+  {
+    auto& base = m_history[pkt.baseSeq % SnapshotHistory];
+
+    if(base.seq != pkt.baseSeq)
+      return DecodeResult::Rejected;
+
+    decoded.size = decodeDelta({ base.data, base.size }, payload, decoded.data);
+  }
+
+  State decodedState;
+
+  if(decoded.size < 0 || !deserializeState({ decoded.data, decoded.size }, decodedState))
+    return DecodeResult::Rejected;
+
+  // we don't have the state the server had
+  if(hashState(decodedState) != pkt.stateHash)
+    return DecodeResult::Rejected;
+
+  m_history[pkt.seq % SnapshotHistory] = decoded;
+  lastSeq = pkt.seq;
+  state = decodedState;
+  return DecodeResult::Decoded;
+}
+
+template<typename State>
+void SnapshotDecoder<State>::reset()
+{
+  lastSeq = 0;
+  restarts++;
+
+  // the old sequence numbers mean nothing to the new instance
+  for(auto& snapshot : m_history)
+    snapshot.seq = 0;
+
+  m_pending.seq = 0;
+  m_pending.receivedMask = 0;
+}
+
+template struct SnapshotDecoder<GameLogicState>;
+template struct SnapshotDecoder<GameLogicState31x21>;
+template struct SnapshotDecoder<GameLogicState63x63>;
@@ -0,0 +1,74 @@
+// Snapshot history, shared by the server (delta encoding)
+// and the clients (delta decoding).
+#pragma once
+
+#include <stdint.h>
+
+#include "game.h"
+#include "protocol.h"
+#include "serialization.h" // maxSerializedSize
+
+// How many past snapshots can be used as delta baselines.
+static const int SnapshotHistory = 32;
+
+// A serialized state (see serialization.h).
+template<int Capacity_>
+struct BasicSnapshot
+{
+  static constexpr int Capacity = Capacity_;
+
+  uint32_t seq = 0;
+  int size = 0;
+  uint8_t data[Capacity];
+};
+
+template<typename State>
+using SnapshotFor = BasicSnapshot<maxSerializedSize<State>()>;
+
+// Number of datagrams needed to send any snapshot of 'State'.
+template<typename State>
+constexpr int fragmentCount()
+{
+  return (maxSerializedSize<State>() + FragmentSize - 1) / FragmentSize;
+}
+
+static_assert(fragmentCount<GameLogicState63x63>() <= MaxFragments);
+
+enum class DecodeResult
+{
+  Decoded, // 'state' was updated
+  Pending, // fragment stored, waiting for the other ones
+  Rejected, // late, duplicated, malformed, delta-encoded against an unknown baseline, or hash mismatch
+};
+
+// Rebuilds states from the (possibly delta-encoded, possibly fragmented)
+// state packets. Instantiated for each MapPreset.
+template<typename State>
+struct SnapshotDecoder
+{
+  using Snapshot = SnapshotFor<State>;
+
+  uint32_t instance = 0; // of the room the snapshots come from, zero before the first one
+  uint32_t lastSeq = 0; // last snapshot decoded, to be acknowledged to the server
+  int restarts = 0; // times the room was seen starting over, with a new instance
+
+  DecodeResult receive(const PacketState& pkt, int payloadSize, State& state);
+
+private:
+  void reset();
+
+  Snapshot m_history[SnapshotHistory];
+
+  // The fragments received so far for the snapshot 'seq'
+  struct Reassembly
+  {
+    uint32_t seq = 0;
+    uint32_t baseSeq = 0;
+    int fragCount = 0;
+    uint32_t receivedMask = 0;
+    int size = 0;
+    uint8_t data[Snapshot::Capacity];
+  };
+
+  Reassembly m_pending;
+};
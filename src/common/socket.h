@@ -6,16 +6,37 @@
 #include "address.h"
 #include "span.h"
 
+struct OutgoingDatagram
+{
+  Address dstAddr;
+  Span<const uint8_t> packet;
+};
+
+struct IncomingDatagram
+{
+  Address sender;
+  Span<uint8_t> buffer; // provided by the caller
+  int len; // size of the received datagram
+};
+
 class Socket
 {
 public:
   Socket(int port);
   ~Socket();
 
-  void send(Address dstAddr, Span<const uint8_t> packet);
+  // Returns false if the datagram couldn't be sent.
+  bool send(Address dstAddr, Span<const uint8_t> packet);
   int recv(Address& sender, Span<uint8_t> buffer);
   int port() const;
 
+  // Batched versions of 'send' and 'recv', using as few syscalls as possible.
+  // 'sendBatch' returns the number of datagrams that couldn't be sent.
+  // 'recvBatch' fills the slots in order and returns how many were filled,
+  // 0 meaning that no data is available.
+  int sendBatch(Span<const OutgoingDatagram> datagrams);
+  int recvBatch(Span<IncomingDatagram> slots);
+
   static Address resolve(String hostname, int port);
 
 private:
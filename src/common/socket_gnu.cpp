@@ -7,6 +7,7 @@
 #include <string.h> // memcpy
 #include <unistd.h> // close
 
+#include <algorithm> // min
 #include <stdexcept>
 #include <string>
 
@@ -56,7 +57,7 @@ Socket::~Socket()
   close(m_sock);
 }
 
-void Socket::send(Address dstAddr, Span<const uint8_t> packet)
+bool Socket::send(Address dstAddr, Span<const uint8_t> packet)
 {
   sockaddr_in addr {};
   addr.sin_family = AF_INET;
@@ -68,7 +69,10 @@ void Socket::send(Address dstAddr, Span<const uint8_t> packet)
   if(sent_bytes != packet.len)
   {
     printf("failed to send packet: %d\n", errno);
+    return false;
   }
+
+  return true;
 }
 
 int Socket::recv(Address& sender, Span<uint8_t> buffer)
@@ -95,6 +99,94 @@ int Socket::recv(Address& sender, Span<uint8_t> buffer)
   return bytes;
 }
 
+int Socket::sendBatch(Span<const OutgoingDatagram> datagrams)
+{
+  static const int MaxBatchSize = 64;
+
+  int dropped = 0;
+
+  while(datagrams.len > 0)
+  {
+    const int count = std::min(datagrams.len, MaxBatchSize);
+
+    sockaddr_in addrs[MaxBatchSize] {};
+    iovec iovs[MaxBatchSize];
+    mmsghdr msgs[MaxBatchSize] {};
+
+    for(int i = 0; i < count; ++i)
+    {
+      auto& dg = datagrams[i];
+      addrs[i].sin_family = AF_INET;
+      addrs[i].sin_addr.s_addr = htonl(dg.dstAddr.address);
+      addrs[i].sin_port = htons(dg.dstAddr.port);
+
+      iovs[i].iov_base = (void*)dg.packet.data;
+      iovs[i].iov_len = dg.packet.len;
+
+      msgs[i].msg_hdr.msg_name = &addrs[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int sent = sendmmsg(m_sock, msgs, count, 0);
+
+    if(sent <= 0)
+    {
+      printf("failed to send packet batch: %d\n", errno);
+
+      // drop the first datagram and carry on with the others
+      sent = 1;
+      dropped++;
+    }
+
+    datagrams += sent;
+  }
+
+  return dropped;
+}
+
+int Socket::recvBatch(Span<IncomingDatagram> slots)
+{
+  static const int MaxBatchSize = 64;
+
+  const int count = std::min(slots.len, MaxBatchSize);
+
+  sockaddr_in addrs[MaxBatchSize];
+  iovec iovs[MaxBatchSize];
+  mmsghdr msgs[MaxBatchSize] {};
+
+  for(int i = 0; i < count; ++i)
+  {
+    iovs[i].iov_base = slots[i].buffer.data;
+    iovs[i].iov_len = slots[i].buffer.len;
+
+    msgs[i].msg_hdr.msg_name = &addrs[i];
+    msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  int received = recvmmsg(m_sock, msgs, count, MSG_DONTWAIT, nullptr);
+
+  if(received == -1)
+  {
+    if(errno != EAGAIN && errno != EWOULDBLOCK)
+      printf("failed to receive packet batch: %d\n", errno);
+
+    return 0;
+  }
+
+  for(int i = 0; i < received; ++i)
+  {
+    slots[i].sender.address = ntohl(addrs[i].sin_addr.s_addr);
+    slots[i].sender.port = ntohs(addrs[i].sin_port);
+    slots[i].len = msgs[i].msg_len;
+  }
+
+  return received;
+}
+
 int Socket::port() const
 {
   struct sockaddr_in sin;
@@ -43,7 +43,7 @@ Socket::~Socket()
   WSACleanup();
 }
 
-void Socket::send(Address dstAddr, Span<const uint8_t> packet)
+bool Socket::send(Address dstAddr, Span<const uint8_t> packet)
 {
   sockaddr_in addr {};
   addr.sin_family = AF_INET;
@@ -56,7 +56,10 @@ void Socket::send(Address dstAddr, Span<const uint8_t> packet)
   {
     printf("failed to send packet\n");
     assert(0);
+    return false;
   }
+
+  return true;
 }
 
 int Socket::recv(Address& sender, Span<uint8_t> buffer)
@@ -83,6 +86,38 @@ int Socket::recv(Address& sender, Span<uint8_t> buffer)
   return bytes;
 }
 
+int Socket::sendBatch(Span<const OutgoingDatagram> datagrams)
+{
+  int dropped = 0;
+
+  // no sendmmsg here
+  for(auto& dg : datagrams)
+  {
+    if(!send(dg.dstAddr, dg.packet))
+      dropped++;
+  }
+
+  return dropped;
+}
+
+int Socket::recvBatch(Span<IncomingDatagram> slots)
+{
+  // no recvmmsg here
+  int count = 0;
+
+  for(auto& slot : slots)
+  {
+    slot.len = recv(slot.sender, slot.buffer);
+
+    if(slot.len <= 0)
+      break;
+
+    ++count;
+  }
+
+  return count;
+}
+
 int Socket::port() const
 {
   struct sockaddr_in sin;
@@ -0,0 +1,103 @@
+#include "state_hash.h"
+
+#include <cmath>
+
+namespace
+{
+// Separate key spaces for the cells, the heroes and the bombs
+enum : uint64_t
+{
+  DomainCell = 1ull << 60,
+  DomainHero = 2ull << 60,
+  DomainBomb = 3ull << 60,
+};
+
+// splitmix64 finalizer: a cheap bijective mix, the same on every platform
+uint64_t mix(uint64_t z)
+{
+  z += 0x9E3779B97F4A7C15ull;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+// Same rounding as the compact encoding (see serialization.cpp)
+uint64_t fixed(float val, int bits)
+{
+  return uint64_t((int)::round(val * 256)) & ((1ull << bits) - 1);
+}
+}
+
+uint64_t cellHash(int index, int board, int item)
+{
+  if(!board && !item)
+    return 0;
+
+  return mix(DomainCell | uint64_t(index) << 8 | uint64_t(board) << 4 | uint64_t(item));
+}
+
+uint64_t heroHash(int slot, const HeroState& hero)
+{
+  if(!hero.enable)
+    return 0;
+
+  const uint64_t fields =
+    fixed(hero.pos.x, 16)
+    | fixed(hero.pos.y, 16) << 16
+    | uint64_t(hero.upgrades & 31) << 32
+    | uint64_t(hero.flamelength) << 37
+    | uint64_t(hero.walkspeed) << 41
+    | uint64_t(hero.maxbombs) << 45
+    | uint64_t(hero.orientation & 3) << 49
+    | uint64_t(hero.dead) << 51
+    | uint64_t(hero.isHoldingBomb) << 52;
+
+  return mix(fields ^ mix(DomainHero | uint64_t(slot)));
+}
+
+uint64_t bombHash(int slot, const BombState& bomb)
+{
+  const uint64_t fields =
+    fixed(bomb.pos.x, 16)
+    | fixed(bomb.pos.y, 16) << 16
+    | fixed(bomb.vel.x, 9) << 32
+    | fixed(bomb.vel.y, 9) << 41
+    | uint64_t(bomb.countdown & 127) << 50
+    | uint64_t(bomb.ownerIndex & 31) << 57
+    | uint64_t(bomb.jelly) << 62;
+
+  return mix(fields ^ mix(DomainBomb | uint64_t(slot)));
+}
+
+template<typename State>
+uint64_t hashBoard(const State& state)
+{
+  uint64_t hash = 0;
+
+  for(int row = 0; row < State::ROWS; ++row)
+    for(int col = 0; col < State::COLS; ++col)
+      hash ^= cellHash(row * State::COLS + col, state.board[row][col], state.items[row][col]);
+
+  return hash;
+}
+
+template<typename State>
+uint64_t hashEntities(const State& state)
+{
+  uint64_t hash = 0;
+
+  for(int i = 0; i < State::MAX_HEROES; ++i)
+    hash ^= heroHash(i, state.heroes[i]);
+
+  for(int i = state.bombs.next(-1); i >= 0; i = state.bombs.next(i))
+    hash ^= bombHash(i, state.bombs[i]);
+
+  return hash;
+}
+
+template uint64_t hashBoard(const GameLogicState&);
+template uint64_t hashEntities(const GameLogicState&);
+template uint64_t hashBoard(const GameLogicState31x21&);
+template uint64_t hashEntities(const GameLogicState31x21&);
+template uint64_t hashBoard(const GameLogicState63x63&);
+template uint64_t hashEntities(const GameLogicState63x63&);
@@ -0,0 +1,37 @@
+// 64-bit Zobrist-style hash of the game states.
+// The hash is the XOR of one key per non-empty board cell, enabled hero,
+// and live bomb, so a change to one of them can be applied by XOR-ing out
+// its old key, and XOR-ing in the new one.
+// Only what the compact encoding transmits is hashed (positions rounded to
+// 1/256th of a cell), so a client can recompute the hash of a decoded
+// snapshot, and compare it to the one the server sent.
+#pragma once
+
+#include <stdint.h>
+
+#include "game.h"
+
+// Key of the cell 'index' (row * COLS + col). Zero for an empty cell.
+uint64_t cellHash(int index, int board, int item);
+
+// Key of the hero in slot 'slot'. Zero for a disabled hero.
+uint64_t heroHash(int slot, const HeroState& hero);
+
+// Key of the live bomb in slot 'slot'.
+uint64_t bombHash(int slot, const BombState& bomb);
+
+// Instantiated for each MapPreset.
+
+// Cells only: the part of the hash the simulation maintains incrementally.
+template<typename State>
+uint64_t hashBoard(const State& state);
+
+// Heroes and bombs: they change on most ticks, so they're rehashed on demand.
+template<typename State>
+uint64_t hashEntities(const State& state);
+
+template<typename State>
+uint64_t hashState(const State& state)
+{
+  return hashBoard(state) ^ hashEntities(state);
+}
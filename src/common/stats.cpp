@@ -1,36 +1,132 @@
 #include "stats.h"
+
+#include <algorithm> // max
+#include <atomic>
+#include <cstring> // memcpy
 #include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
 namespace
 {
-std::vector<StatVal> g_Values;
-std::map<std::string, int> g_Map;
+const int MaxStats = 256;
+
+// The slots of one recording thread.
+// A slot packs the value with the epoch it was recorded in (zero: never),
+// so a single store updates both, and readers can tell which thread
+// recorded last.
+struct Shard
+{
+  std::atomic<uint64_t> slots[MaxStats] {};
+};
+
+// Incremented by each read, so the values recorded after a read
+// win over the ones recorded before it.
+std::atomic<uint32_t> g_epoch { 1 };
+
+struct Registry
+{
+  std::mutex mutex; // protects everything but 'count'
+  std::map<std::string, int> indices;
+  std::string names[MaxStats];
+  std::atomic<int> count { 0 };
+
+  // never freed: the values of a thread outlive it
+  std::vector<std::unique_ptr<Shard>> shards;
+};
+
+// Function-local, so stats can be registered during static initialization
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+thread_local Shard* t_shard = nullptr;
+
+Shard& createShard()
+{
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.shards.push_back(std::make_unique<Shard>());
+  return *r.shards.back();
+}
 }
 
-void Stat(String name, float value)
+StatId registerStat(String name)
 {
-  std::string key(name.data, name.data + name.len);
-  auto i = g_Map.find(key);
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
 
-  if(i == g_Map.end())
-  {
-    g_Map[key] = (int)g_Values.size();
-    g_Values.push_back({ name, value });
-    i = g_Map.find(key);
-  }
+  // string literals come with their terminator
+  while(name.len > 0 && name.data[name.len - 1] == 0)
+    --name.len;
+
+  const std::string key(name.data, name.len);
+  auto i = r.indices.find(key);
+
+  if(i != r.indices.end())
+    return { i->second };
+
+  const int index = r.count;
+
+  if(index >= MaxStats)
+    throw std::runtime_error("Too many stats");
 
-  g_Values[i->second] = { name, value };
+  r.names[index] = key;
+  r.indices[key] = index;
+  r.count = index + 1;
+
+  return { index };
+}
+
+void Stat(StatId id, float value)
+{
+  if(!t_shard)
+    t_shard = &createShard();
+
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof bits);
+
+  const uint64_t epoch = g_epoch.load(std::memory_order_relaxed);
+  t_shard->slots[id.index].store(epoch << 32 | bits, std::memory_order_relaxed);
 }
 
 int getStatCount()
 {
-  return (int)g_Values.size();
+  return registry().count;
 }
 
-StatVal getStat(int idx)
+String getStatName(StatId id)
 {
-  return g_Values.at(idx);
+  return registry().names[id.index];
 }
 
+StatVal getStat(int idx)
+{
+  auto& r = registry();
+
+  if(idx < 0 || idx >= r.count)
+    throw std::out_of_range("Invalid stat index");
+
+  uint64_t latest = 0;
+
+  {
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    // the epoch is in the high bits
+    for(auto& shard : r.shards)
+      latest = std::max(latest, shard->slots[idx].load(std::memory_order_relaxed));
+  }
+
+  g_epoch.fetch_add(1, std::memory_order_relaxed);
+
+  const uint32_t bits = uint32_t(latest);
+  float value;
+  memcpy(&value, &bits, sizeof value);
+
+  return { r.names[idx], value };
+}
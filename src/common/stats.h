@@ -1,15 +1,37 @@
+// Named values, for monitoring: shown by the client's GUI,
+// and exported by the server metrics.
+// A name is registered once, and gives a handle:
+//
+//   static const auto s_drawCalls = registerStat("Draw Calls");
+//   Stat(s_drawCalls, bags.size());
+//
+// Recording is a single store into a slot of the calling thread, so any
+// thread can record, without allocating or locking. Readers merge the slots
+// of all the threads.
 #pragma once
 
 #include "span.h"
 
+struct StatId
+{
+  int index;
+};
+
+// Thread-safe. Registering a name again returns the same handle.
+StatId registerStat(String name);
+
+void Stat(StatId id, float value);
+
+String getStatName(StatId id);
+
 struct StatVal
 {
   String name;
+  // The most recent value. When several threads recorded it since
+  // the previous read, the value of one of them.
   float val;
 };
 
-void Stat(String name, float value);
-
+// The stats registered so far, by registration order.
 int getStatCount();
 StatVal getStat(int idx);
-
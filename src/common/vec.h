@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 struct Vec2i
 {
   int x, y;
@@ -10,6 +12,8 @@ struct Vec2i
 
 struct Vec2f
 {
+  using Scalar = float;
+
   float x, y;
 
   Vec2f() = default;
@@ -29,6 +33,80 @@ struct Vec2f
   static Vec2f zero() { return Vec2f(0, 0); }
 };
 
+// Signed fixed-point number, with 16 fractional bits.
+// Only uses integer math, so the results don't depend on the compiler,
+// its flags, or the platform.
+// Floats can hold any value below 256 exactly, so converting back and forth is lossless.
+struct Fixed
+{
+  static constexpr int FracBits = 16;
+  static constexpr int32_t One = 1 << FracBits;
+
+  int32_t raw;
+
+  Fixed() = default;
+  constexpr explicit Fixed(int i) : raw(i * One) {}
+
+  // Meant for constants, which are converted at compile time
+  constexpr explicit Fixed(double d) : raw(int32_t(d * One + (d < 0 ? -0.5 : 0.5))) {}
+
+  static constexpr Fixed fromRaw(int32_t r) { Fixed f {}; f.raw = r; return f; }
+  static Fixed fromFloat(float f) { return fromRaw(int32_t(f * One)); }
+  float toFloat() const { return raw / float(One); }
+
+  Fixed operator + (Fixed other) const { return fromRaw(raw + other.raw); }
+  Fixed operator - (Fixed other) const { return fromRaw(raw - other.raw); }
+  Fixed operator - () const { return fromRaw(-raw); }
+  Fixed operator * (Fixed other) const { return fromRaw(int32_t((int64_t(raw) * other.raw) >> FracBits)); }
+  Fixed operator * (int n) const { return fromRaw(raw * n); }
+  void operator += (Fixed other) { raw += other.raw; }
+  void operator -= (Fixed other) { raw -= other.raw; }
+
+  bool operator == (Fixed other) const { return raw == other.raw; }
+  bool operator != (Fixed other) const { return raw != other.raw; }
+  bool operator < (Fixed other) const { return raw < other.raw; }
+  bool operator > (Fixed other) const { return raw > other.raw; }
+  bool operator <= (Fixed other) const { return raw <= other.raw; }
+  bool operator >= (Fixed other) const { return raw >= other.raw; }
+  explicit operator bool () const { return raw != 0; }
+
+  // Nearest integer, halfway cases away from zero (like ::round)
+  int round() const
+  {
+    if(raw < 0)
+      return -((-raw + One / 2) >> FracBits);
+
+    return (raw + One / 2) >> FracBits;
+  }
+};
+
+// Fixed-point counterpart of Vec2f
+struct Vec2x
+{
+  using Scalar = Fixed;
+
+  Fixed x, y;
+
+  Vec2x() = default;
+  constexpr Vec2x(Fixed x_, Fixed y_) : x(x_), y(y_) {}
+
+  static Vec2x fromFloat(Vec2f v) { return Vec2x(Fixed::fromFloat(v.x), Fixed::fromFloat(v.y)); }
+  Vec2f toFloat() const { return Vec2f(x.toFloat(), y.toFloat()); }
+
+  Fixed operator * (Vec2x other) const
+  {
+    return Fixed::fromRaw(int32_t((int64_t(x.raw) * other.x.raw + int64_t(y.raw) * other.y.raw) >> Fixed::FracBits));
+  }
+
+  Vec2x operator + (Vec2x other) const { return Vec2x { x + other.x, y + other.y }; }
+  Vec2x operator - (Vec2x other) const { return Vec2x { x - other.x, y - other.y }; }
+  Vec2x operator * (Fixed f) const { return Vec2x { x* f, y* f }; }
+
+  bool operator == (Vec2x other) const { return x == other.x && y == other.y; };
+
+  static Vec2x zero() { return Vec2x(Fixed(0), Fixed(0)); }
+};
+
 struct Vec4f
 {
   Vec4f() = default;
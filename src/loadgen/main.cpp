@@ -0,0 +1,458 @@
+// load generator:
+// simulates many headless clients against a game server,
+// and reports how the server keeps up.
+// Each simulated client has its own UDP socket, so the server sees it as a
+// distinct player. It joins a room, streams inputs, acknowledges snapshots,
+// and measures the state packet inter-arrival times, the losses, and the join latency.
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib> // atoi
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "clock.h"
+#include "protocol.h"
+#include "snapshots.h"
+#include "socket.h"
+#include "span.h"
+
+namespace
+{
+struct Config
+{
+  std::string host = "127.0.0.1";
+  int clientCount = 16;
+  int clientsPerRoom = 4;
+  int firstRoom = 0;
+  int durationSec = 10;
+  int inputPeriodMs = GamePeriodMs; // one input per server tick, like the client. Shorter periods stress the server's input skipping
+  bool scripted = false; // replay a fixed input sequence instead of random inputs
+  MapPreset preset = MapPreset::Classic; // of the rooms we open
+};
+
+const int64_t Ms = 1000000;
+
+// Inter-arrival times histogram, in milliseconds.
+struct Histogram
+{
+  static constexpr int MaxMs = 1000;
+  int64_t buckets[MaxMs + 1] {};
+  int64_t count = 0;
+  int64_t sum = 0;
+  int max = 0;
+
+  void add(int ms)
+  {
+    ms = std::min(std::max(ms, 0), MaxMs);
+    buckets[ms]++;
+    count++;
+    sum += ms;
+    max = std::max(max, ms);
+  }
+
+  int percentile(double p) const
+  {
+    const int64_t target = int64_t(count * p);
+    int64_t acc = 0;
+
+    for(int i = 0; i <= MaxMs; ++i)
+    {
+      acc += buckets[i];
+
+      if(acc > target)
+        return i;
+    }
+
+    return MaxMs;
+  }
+
+  double mean() const { return count ? double(sum) / count : 0.0; }
+};
+
+// Decodes the states of any preset.
+struct StateReceiver
+{
+  virtual ~StateReceiver() = default;
+  virtual DecodeResult receive(const PacketState& pkt, int payloadSize) = 0;
+  virtual uint32_t lastSeq() const = 0;
+};
+
+template<typename State>
+struct StateReceiverImpl : StateReceiver
+{
+  DecodeResult receive(const PacketState& pkt, int payloadSize) override
+  {
+    return decoder.receive(pkt, payloadSize, state);
+  }
+
+  uint32_t lastSeq() const override { return decoder.lastSeq; }
+
+  SnapshotDecoder<State> decoder;
+  State state {};
+};
+
+struct Client
+{
+  Client(int roomId_, MapPreset preset) : sock(0), roomId(roomId_)
+  {
+    visitPreset(preset, [&] (auto tag) { receiver = std::make_unique<StateReceiverImpl<typename decltype(tag)::type>>(); });
+  }
+
+  Socket sock;
+  const int roomId;
+
+  std::unique_ptr<StateReceiver> receiver;
+  PlayerInputState input {};
+  uint8_t sentInputs[MaxInputHistory] {}; // packed, by input number modulo MaxInputHistory
+  uint32_t rngState = 0;
+
+  int64_t joinDate = 0;
+  int64_t firstStateDate = -1;
+  int64_t lastStateDate = -1;
+  int64_t lastInputDate = 0;
+  int64_t inputCount = 0;
+
+  int64_t received = 0;
+  int64_t lost = 0;
+  int64_t undecodable = 0;
+  int64_t bytesIn = 0;
+  Histogram interArrival;
+
+  template<typename T>
+  void sendPacket(Address server, T pkt)
+  {
+    pkt.hdr.roomId = roomId;
+    sock.send(server, { (const uint8_t*)&pkt, int(sizeof pkt) });
+  }
+};
+
+int random(uint32_t& state, int n)
+{
+  state = state * 1664525u + 1013904223u;
+  return int((state >> 16) % uint32_t(n));
+}
+
+// Changes direction from time to time, and drops bombs.
+void generateRandomInput(Client& client)
+{
+  auto& in = client.input;
+
+  if(random(client.rngState, 20) == 0)
+  {
+    in = {};
+
+    switch(random(client.rngState, 5))
+    {
+    case 0: in.left = true;
+      break;
+    case 1: in.right = true;
+      break;
+    case 2: in.up = true;
+      break;
+    case 3: in.down = true;
+      break;
+    }
+  }
+
+  in.dropBomb = random(client.rngState, 30) == 0;
+}
+
+// Walks in a square, dropping a bomb at each corner.
+void generateScriptedInput(Client& client)
+{
+  auto& in = client.input;
+  in = {};
+
+  const int64_t frame = client.inputCount;
+  const int step = int(frame / 30) % 4;
+  in.right = step == 0;
+  in.down = step == 1;
+  in.left = step == 2;
+  in.up = step == 3;
+  in.dropBomb = frame % 30 == 0;
+}
+
+void receivePackets(Client& client, int64_t now)
+{
+  static uint8_t buffers[64][2048];
+  IncomingDatagram slots[64];
+
+  for(int i = 0; i < 64; ++i)
+    slots[i].buffer = buffers[i];
+
+  for(;;)
+  {
+    const int n = client.sock.recvBatch(slots);
+
+    for(int i = 0; i < n; ++i)
+    {
+      auto& slot = slots[i];
+
+      if(slot.len < (int)sizeof(PacketStateHeader) || slot.buffer[0] != Op::State)
+        continue;
+
+      auto pkt = (const PacketState*)slot.buffer.data;
+      const uint32_t prevSeq = client.receiver->lastSeq();
+
+      client.bytesIn += slot.len;
+
+      // heartbeats included: the server is alive
+      if(pkt->fragIndex == 0)
+      {
+        if(client.lastStateDate >= 0)
+          client.interArrival.add(int((now - client.lastStateDate) / Ms));
+
+        client.lastStateDate = now;
+      }
+
+      if(pkt->fragCount == 0)
+        continue; // heartbeat
+
+      const auto result = client.receiver->receive(*pkt, slot.len - (int)sizeof(PacketStateHeader));
+
+      if(result == DecodeResult::Pending)
+        continue;
+
+      if(result == DecodeResult::Rejected)
+      {
+        // the server resends the last snapshot until we acknowledge it
+        if(pkt->seq != prevSeq)
+          client.undecodable++;
+
+        continue;
+      }
+
+      if(prevSeq && pkt->seq > prevSeq + 1)
+        client.lost += pkt->seq - prevSeq - 1;
+
+      if(client.firstStateDate < 0)
+        client.firstStateDate = now;
+
+      client.received++;
+    }
+
+    if(n < 64)
+      break;
+  }
+}
+
+Config parseCommandLine(Span<const String> args)
+{
+  Config config;
+
+  auto stringArg = [&] (int& i)
+    {
+      if(i + 1 >= args.len)
+        throw std::runtime_error("Missing value for option");
+
+      ++i;
+      return std::string(args[i].data, args[i].len);
+    };
+
+  auto intArg = [&] (int& i)
+    {
+      return atoi(stringArg(i).c_str());
+    };
+
+  for(int i = 1; i < args.len; ++i)
+  {
+    const std::string arg(args[i].data, args[i].len);
+
+    if(arg == "--clients")
+      config.clientCount = intArg(i);
+    else if(arg == "--per-room")
+      config.clientsPerRoom = intArg(i);
+    else if(arg == "--first-room")
+      config.firstRoom = intArg(i);
+    else if(arg == "--duration")
+      config.durationSec = intArg(i);
+    else if(arg == "--input-period")
+      config.inputPeriodMs = intArg(i);
+    else if(arg == "--scripted")
+      config.scripted = true;
+    else if(arg == "--preset")
+    {
+      const auto name = stringArg(i);
+
+      if(!parseMapPreset(name.c_str(), config.preset))
+        throw std::runtime_error("Unknown map preset: '" + name + "'");
+    }
+    else if(arg.size() && arg[0] != '-')
+      config.host = arg;
+    else
+      throw std::runtime_error("Unknown option: '" + arg + "'");
+  }
+
+  int maxHeroes = 0;
+  visitPreset(config.preset, [&] (auto tag) { maxHeroes = decltype(tag)::type::MAX_HEROES; });
+
+  if(config.clientsPerRoom < 1 || config.clientsPerRoom > maxHeroes)
+    throw std::runtime_error("Invalid number of clients per room");
+
+  if(config.inputPeriodMs < 1)
+    throw std::runtime_error("Invalid input period");
+
+  return config;
+}
+
+void printReport(const std::vector<std::unique_ptr<Client>>& clients, int64_t duration)
+{
+  Histogram all;
+  int64_t received = 0;
+  int64_t lost = 0;
+  int64_t undecodable = 0;
+  int64_t bytesIn = 0;
+  int64_t worstJoin = 0;
+  int neverJoined = 0;
+
+  printf("\n");
+  printf("client room   states   lost  undec  mean(ms)  p99(ms)  max(ms)  join(ms)\n");
+
+  for(auto& c : clients)
+  {
+    const int idx = int(&c - clients.data());
+
+    for(int i = 0; i <= Histogram::MaxMs; ++i)
+      all.buckets[i] += c->interArrival.buckets[i];
+
+    all.count += c->interArrival.count;
+    all.sum += c->interArrival.sum;
+    all.max = std::max(all.max, c->interArrival.max);
+
+    received += c->received;
+    lost += c->lost;
+    undecodable += c->undecodable;
+    bytesIn += c->bytesIn;
+
+    int64_t joinMs = -1;
+
+    if(c->firstStateDate >= 0)
+    {
+      joinMs = (c->firstStateDate - c->joinDate) / Ms;
+      worstJoin = std::max(worstJoin, joinMs);
+    }
+    else
+    {
+      neverJoined++;
+    }
+
+    printf("%6d %4d %8lld %6lld %6lld %9.1f %8d %8d %9lld\n",
+           idx, c->roomId,
+           (long long)c->received, (long long)c->lost, (long long)c->undecodable,
+           c->interArrival.mean(), c->interArrival.percentile(0.99), c->interArrival.max,
+           (long long)joinMs);
+  }
+
+  const double seconds = duration / 1e9;
+  const double lossRatio = received + lost ? 100.0 * lost / (received + lost) : 0.0;
+
+  printf("\n");
+  printf("---- summary ----\n");
+  printf("clients: %d (%d never got a state)\n", (int)clients.size(), neverJoined);
+  printf("states received: %lld (%.1f/s), %.1f kB/s\n", (long long)received, received / seconds, bytesIn / seconds / 1024.0);
+  printf("states lost: %lld (%.2f%%), undecodable: %lld\n", (long long)lost, lossRatio, (long long)undecodable);
+  printf("inter-arrival (ms): mean=%.2f p50=%d p90=%d p99=%d max=%d (expected: %d)\n",
+         all.mean(), all.percentile(0.5), all.percentile(0.9), all.percentile(0.99), all.max, GamePeriodMs);
+  printf("worst join latency: %lld ms\n", (long long)worstJoin);
+}
+}
+
+void safeMain(Span<const String> args)
+{
+  const auto config = parseCommandLine(args);
+  const auto server = Socket::resolve({ config.host.data(), (int)config.host.size() }, ServerUdpPort);
+
+  printf("Simulating %d clients against %s, %d per room, map %s\n", config.clientCount, server.toString().c_str(), config.clientsPerRoom, mapPresetName(config.preset));
+
+  std::vector<std::unique_ptr<Client>> clients;
+
+  for(int i = 0; i < config.clientCount; ++i)
+  {
+    const int roomId = config.firstRoom + i / config.clientsPerRoom;
+
+    if(roomId >= MaxRooms)
+      throw std::runtime_error("Too many rooms");
+
+    clients.push_back(std::make_unique<Client>(roomId, config.preset));
+    clients.back()->rngState = i;
+  }
+
+  const int64_t start = getMonotonicTimeNs();
+  const int64_t end = start + config.durationSec * 1000 * Ms;
+  const int64_t inputPeriod = config.inputPeriodMs * Ms;
+
+  for(auto& c : clients)
+  {
+    PacketKeepAlive pkt {};
+    pkt.hdr.op = Op::KeepAlive;
+    pkt.preset = config.preset;
+    c->sendPacket(server, pkt);
+    c->joinDate = getMonotonicTimeNs();
+    c->lastInputDate = c->joinDate;
+  }
+
+  int64_t nextWakeUp = start;
+  int64_t nextProgress = start + 1000 * Ms;
+
+  while(getMonotonicTimeNs() < end)
+  {
+    // don't try to catch up if we fell behind
+    nextWakeUp = std::max(nextWakeUp + Ms, getMonotonicTimeNs());
+    sleepUntil(nextWakeUp);
+
+    const int64_t now = getMonotonicTimeNs();
+
+    for(auto& c : clients)
+    {
+      receivePackets(*c, now);
+
+      if(now - c->lastInputDate >= inputPeriod)
+      {
+        c->lastInputDate += inputPeriod;
+
+        if(config.scripted)
+          generateScriptedInput(*c);
+        else
+          generateRandomInput(*c);
+
+        c->inputCount++;
+
+        c->sentInputs[c->inputCount % MaxInputHistory] = packInput(c->input);
+
+        PacketPlayerInput pkt {};
+        pkt.hdr.op = Op::PlayerInput;
+        pkt.inputSeq = c->inputCount;
+        pkt.ackSeq = c->receiver->lastSeq();
+        pkt.inputCount = std::min<int64_t>(c->inputCount, MaxInputHistory);
+
+        for(int i = 0; i < pkt.inputCount; ++i)
+          pkt.inputs[i] = c->sentInputs[(c->inputCount - i) % MaxInputHistory];
+
+        c->sendPacket(server, pkt);
+      }
+    }
+
+    if(now >= nextProgress)
+    {
+      nextProgress += 1000 * Ms;
+
+      int64_t received = 0;
+
+      for(auto& c : clients)
+        received += c->received;
+
+      printf("t=%llds: %lld states received\n", (long long)((now - start) / (1000 * Ms)), (long long)received);
+    }
+  }
+
+  for(auto& c : clients)
+  {
+    PacketDisconnect pkt {};
+    pkt.hdr.op = Op::Disconnect;
+    c->sendPacket(server, pkt);
+  }
+
+  printReport(clients, getMonotonicTimeNs() - start);
+}
@@ -0,0 +1,342 @@
+// Self-play simulator:
+// runs many complete bot-vs-bot matches, spread over all the cores,
+// and writes per-match statistics, to tune the game balance (e.g the item
+// counts) from the outcome of thousands of games.
+// Each match is seeded from its index, so the results don't depend on the
+// number of threads.
+#include <algorithm> // max
+#include <atomic>
+#include <cstdio>
+#include <cstdlib> // atoi, atoll
+#include <exception> // exception_ptr
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bots.h"
+#include "clock.h"
+#include "gamelogic.h"
+#include "span.h"
+
+namespace
+{
+struct Config
+{
+  int matches = 1000;
+  int threads = 0; // 0: one per core
+  int bots = 4;
+  int maxTicks = 20000; // a match still running after that is a draw
+  uint64_t seed = 1;
+  bool instantChains = false;
+  bool fixedPoint = false;
+  bool binary = false;
+  MapPreset preset = MapPreset::Classic;
+  std::string outPath = "selfplay.csv";
+};
+
+// Outcome of one match.
+// Also the record layout of the binary output (see writeBinary).
+struct MatchStats
+{
+  uint32_t ticks;
+  uint32_t bombsDropped;
+  int8_t winner; // hero slot, -1 when nobody survived
+  uint8_t timeout; // stopped at Config::maxTicks
+  uint16_t itemsPicked[MAX_ITEM]; // indexed by item type, as found on the board
+  uint8_t unused[2]; // explicit padding, always zero
+};
+
+static_assert(sizeof(MatchStats) == 40);
+
+const char* const itemNames[MAX_ITEM] =
+{
+  "undef", "disease", "kick", "flame", "punch", "skate", "bomb",
+  "tribomb", "goldflame", "ebola", "trigger", "random", "jelly", "glove",
+};
+
+uint64_t matchSeed(const Config& config, int index)
+{
+  // splitmix64, so neighbouring matches get unrelated maps
+  uint64_t z = config.seed + uint64_t(index) * 0x9E3779B97F4A7C15ull;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+// Items only leave the board when picked up, and a bomb slot can't be freed
+// and reallocated within the same tick: both are counted from the
+// difference between two consecutive states.
+template<typename State>
+void accumulate(MatchStats& stats, const State& before, const State& after)
+{
+  for(int row = 0; row < State::ROWS; ++row)
+  {
+    for(int col = 0; col < State::COLS; ++col)
+    {
+      const int item = before.items[row][col];
+
+      if(item && !after.items[row][col])
+        ++stats.itemsPicked[item];
+    }
+  }
+
+  for(int w = 0; w < State::BombPool::Words; ++w)
+    stats.bombsDropped += __builtin_popcountll(after.bombs.live[w] & ~before.bombs.live[w]);
+}
+
+// Plays one match to its end, with bots in the first 'config.bots' slots.
+template<typename State>
+MatchStats playMatch(const Config& config, int index, BasicGameMatch<State>& match, State& state, State& next)
+{
+  match = {};
+  match.verbose = false;
+  match.instantChains = config.instantChains;
+  match.fixedPoint = config.fixedPoint;
+  match.rng.seed(matchSeed(config, index));
+  state = initGame(match);
+
+  for(int i = 0; i < State::MAX_HEROES; ++i)
+    state.heroes[i].enable = i < config.bots;
+
+  const uint64_t botMask = config.bots >= 64 ? ~0ull : (1ull << config.bots) - 1;
+
+  BotTeam<State> bots;
+  PlayerInputState inputs[State::MAX_HEROES] {};
+  MatchStats stats {};
+
+  while(match.intergameTimer == 0)
+  {
+    if(int(stats.ticks) >= config.maxTicks)
+    {
+      stats.timeout = true;
+      break;
+    }
+
+    // no time budget: every bot thinks every tick, so the match is reproducible
+    bots.think(state, botMask, inputs, INT64_MAX);
+    next = advanceGameLogic(match, state, inputs);
+    accumulate(stats, state, next);
+    state = next;
+    ++stats.ticks;
+  }
+
+  stats.winner = -1;
+
+  if(!stats.timeout)
+  {
+    for(int i = 0; i < State::MAX_HEROES; ++i)
+    {
+      if(state.heroes[i].enable && !state.heroes[i].dead)
+        stats.winner = i;
+    }
+
+    // the next game must keep the bots in play
+    while(match.intergameTimer > 0)
+      state = advanceGameLogic(match, state, inputs);
+
+    for(int i = 0; i < config.bots; ++i)
+    {
+      if(!state.heroes[i].enable)
+        throw std::runtime_error("Hero " + std::to_string(i) + " left the game at a reset");
+    }
+  }
+
+  return stats;
+}
+
+template<typename State>
+void worker(const Config& config, std::atomic<int>& nextMatch, std::vector<MatchStats>& results)
+{
+  // heap-allocated: the big presets don't fit comfortably on a thread stack
+  auto match = std::make_unique<BasicGameMatch<State>>();
+  auto state = std::make_unique<State>();
+  auto next = std::make_unique<State>();
+
+  for(;;)
+  {
+    const int index = nextMatch++;
+
+    if(index >= config.matches)
+      break;
+
+    results[index] = playMatch(config, index, *match, *state, *next);
+  }
+}
+
+void writeCsv(FILE* fp, const Config& config, const std::vector<MatchStats>& results)
+{
+  fprintf(fp, "match,seed,ticks,winner,timeout,bombs_dropped");
+
+  for(int k = 1; k < MAX_ITEM; ++k)
+    fprintf(fp, ",%s", itemNames[k]);
+
+  fprintf(fp, "\n");
+
+  for(int i = 0; i < (int)results.size(); ++i)
+  {
+    auto& r = results[i];
+    fprintf(fp, "%d,%llu,%u,%d,%d,%u", i, (unsigned long long)matchSeed(config, i), r.ticks, r.winner, r.timeout, r.bombsDropped);
+
+    for(int k = 1; k < MAX_ITEM; ++k)
+      fprintf(fp, ",%d", r.itemsPicked[k]);
+
+    fprintf(fp, "\n");
+  }
+}
+
+// Binary layout (native endianness):
+// "BSP1", uint32 record size, uint32 record count, then the MatchStats records.
+void writeBinary(FILE* fp, const std::vector<MatchStats>& results)
+{
+  const uint32_t header[] = { uint32_t(sizeof(MatchStats)), uint32_t(results.size()) };
+  fwrite("BSP1", 1, 4, fp);
+  fwrite(header, sizeof header, 1, fp);
+  fwrite(results.data(), sizeof(MatchStats), results.size(), fp);
+}
+
+template<typename State>
+void run(const Config& config)
+{
+  std::vector<MatchStats> results(config.matches);
+  std::atomic<int> nextMatch {0};
+
+  printf("Playing %d matches (map %s, %d bots) on %d threads\n",
+         config.matches, mapPresetName(State::PRESET), config.bots, config.threads);
+
+  const int64_t start = getMonotonicTimeNs();
+
+  std::vector<std::thread> threads;
+
+  std::vector<std::exception_ptr> errors(config.threads);
+
+  for(int i = 0; i < config.threads; ++i)
+  {
+    threads.emplace_back([&, i] ()
+      {
+        try
+        {
+          worker<State>(config, nextMatch, results);
+        }
+        catch(...)
+        {
+          errors[i] = std::current_exception();
+        }
+      });
+  }
+
+  for(auto& t : threads)
+    t.join();
+
+  for(auto& e : errors)
+  {
+    if(e)
+      std::rethrow_exception(e);
+  }
+
+  const double elapsed = (getMonotonicTimeNs() - start) / 1e9;
+
+  int64_t ticks = 0;
+  int draws = 0;
+  int timeouts = 0;
+
+  for(auto& r : results)
+  {
+    ticks += r.ticks;
+    draws += r.winner < 0;
+    timeouts += r.timeout;
+  }
+
+  printf("done in %.1fs (%.0f matches/s, %.0f ticks/s)\n", elapsed, config.matches / elapsed, ticks / elapsed);
+  printf("average duration: %.0f ticks, draws: %d, timeouts: %d\n", double(ticks) / config.matches, draws, timeouts);
+
+  FILE* fp = fopen(config.outPath.c_str(), config.binary ? "wb" : "w");
+
+  if(!fp)
+    throw std::runtime_error("Can't open '" + config.outPath + "' for writing");
+
+  if(config.binary)
+    writeBinary(fp, results);
+  else
+    writeCsv(fp, config, results);
+
+  const bool failed = ferror(fp);
+  fclose(fp);
+
+  if(failed)
+    throw std::runtime_error("Can't write '" + config.outPath + "'");
+
+  printf("Wrote '%s'\n", config.outPath.c_str());
+}
+
+Config parseCommandLine(Span<const String> args)
+{
+  Config config;
+
+  auto stringArg = [&] (int& i)
+    {
+      if(i + 1 >= args.len)
+        throw std::runtime_error("Missing value for option");
+
+      ++i;
+      return std::string(args[i].data, args[i].len);
+    };
+
+  for(int i = 1; i < args.len; ++i)
+  {
+    const std::string arg(args[i].data, args[i].len);
+
+    if(arg == "--matches")
+      config.matches = atoi(stringArg(i).c_str());
+    else if(arg == "--threads")
+      config.threads = atoi(stringArg(i).c_str());
+    else if(arg == "--bots")
+      config.bots = atoi(stringArg(i).c_str());
+    else if(arg == "--max-ticks")
+      config.maxTicks = atoi(stringArg(i).c_str());
+    else if(arg == "--seed")
+      config.seed = atoll(stringArg(i).c_str());
+    else if(arg == "--instant-chains")
+      config.instantChains = true;
+    else if(arg == "--fixed-point")
+      config.fixedPoint = true;
+    else if(arg == "--binary")
+      config.binary = true;
+    else if(arg == "--preset")
+    {
+      const auto name = stringArg(i);
+
+      if(!parseMapPreset(name.c_str(), config.preset))
+        throw std::runtime_error("Unknown map preset: '" + name + "'");
+    }
+    else if(arg == "-o")
+      config.outPath = stringArg(i);
+    else
+      throw std::runtime_error("Unknown option: '" + arg + "'");
+  }
+
+  int maxHeroes = 0;
+  visitPreset(config.preset, [&] (auto tag) { maxHeroes = spawnCount<typename decltype(tag)::type>(); });
+
+  if(config.bots < 2 || config.bots > maxHeroes)
+    throw std::runtime_error("Invalid bot count");
+
+  if(config.matches < 1)
+    throw std::runtime_error("Invalid match count");
+
+  if(config.maxTicks < 1)
+    throw std::runtime_error("Invalid max tick count");
+
+  if(config.threads <= 0)
+    config.threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+  return config;
+}
+}
+
+void safeMain(Span<const String> args)
+{
+  const auto config = parseCommandLine(args);
+  visitPreset(config.preset, [&] (auto tag) { run<typename decltype(tag)::type>(config); });
+}
@@ -0,0 +1,460 @@
+#include "bots.h"
+
+#include <algorithm> // min, max, fill
+#include <cmath>
+#include <cstring> // memset
+
+#include "clock.h"
+#include "protocol.h" // GamePeriodMs
+
+namespace
+{
+const int16_t Never = INT16_MAX;
+
+// Safety margin, in ticks, around the times the flames cover a cell
+const int Margin = 3;
+
+// Bots only look for goals this many cells away
+const int MaxSearchSteps = 16;
+
+// Ticks between dropping a bomb and its explosion
+const int FuseTicks = 75 - 10;
+
+const Vec2i dirs[4] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+template<typename State>
+bool isInside(Vec2i p)
+{
+  return unsigned(p.y) < unsigned(State::ROWS) && unsigned(p.x) < unsigned(State::COLS);
+}
+
+Vec2i cellOf(Vec2f pos)
+{
+  return { (int)::round(pos.x), (int)::round(pos.y) };
+}
+
+// Calls 'f' on each cell the flames of a bomb at 'pos' would cover.
+template<typename State, typename Func>
+void forEachFlameCell(const State& state, Vec2i pos, int flamelength, Func f)
+{
+  if(!isInside<State>(pos))
+    return;
+
+  f(pos);
+
+  for(auto dir : dirs)
+  {
+    for(int i = 1; i <= flamelength; ++i)
+    {
+      const auto p = pos + dir * i;
+
+      if(!isInside<State>(p) || state.board[p.y][p.x] != 0)
+        break;
+
+      f(p);
+    }
+  }
+}
+
+// When each cell will be covered with flames, in ticks from now,
+// according to the bomb countdowns, including the chain reactions.
+// Shared by all the bots of the match.
+template<typename State>
+struct DangerMap
+{
+  int16_t start[State::ROWS][State::COLS]; // Never if no bomb threatens the cell
+  int16_t end[State::ROWS][State::COLS];
+  int16_t bombAt[State::ROWS][State::COLS]; // one of the bombs of the cell, or -1
+  int ownerCount[State::MAX_HEROES];
+
+  bool isSafe(Vec2i p) const { return start[p.y][p.x] == Never; }
+
+  // The cell is free of flames from tick 't0' to tick 't1'.
+  bool isSafeDuring(Vec2i p, int t0, int t1) const
+  {
+    return start[p.y][p.x] > t1 + Margin || end[p.y][p.x] + Margin < t0;
+  }
+};
+
+template<typename State>
+void buildDangerMap(DangerMap<State>& m, const State& state)
+{
+  std::fill(&m.start[0][0], &m.start[0][0] + State::ROWS * State::COLS, Never);
+  memset(m.end, 0, sizeof m.end);
+  memset(m.bombAt, 0xff, sizeof m.bombAt);
+  memset(m.ownerCount, 0, sizeof m.ownerCount);
+
+  int16_t when[State::MAX_BOMBS]; // ticks until the bomb explodes
+
+  for(int i = state.bombs.next(-1); i >= 0; i = state.bombs.next(i))
+  {
+    auto& b = state.bombs[i];
+    const auto cell = cellOf(b.pos);
+    when[i] = std::max(0, b.countdown - 10);
+    m.ownerCount[b.ownerIndex]++;
+
+    if(isInside<State>(cell))
+      m.bombAt[cell.y][cell.x] = i;
+  }
+
+  // a bomb goes off as soon as the flames of another one reach it
+  for(bool changed = true; changed;)
+  {
+    changed = false;
+
+    for(int i = state.bombs.next(-1); i >= 0; i = state.bombs.next(i))
+    {
+      auto& b = state.bombs[i];
+
+      forEachFlameCell(state, cellOf(b.pos), state.heroes[b.ownerIndex].flamelength, [&] (Vec2i p)
+        {
+          const int j = m.bombAt[p.y][p.x];
+
+          if(j >= 0 && when[j] > when[i])
+          {
+            when[j] = when[i];
+            changed = true;
+          }
+        });
+    }
+  }
+
+  for(int i = state.bombs.next(-1); i >= 0; i = state.bombs.next(i))
+  {
+    auto& b = state.bombs[i];
+    const int16_t t0 = when[i];
+    const int16_t t1 = b.countdown > 10 ? t0 + 10 : b.countdown;
+
+    forEachFlameCell(state, cellOf(b.pos), state.heroes[b.ownerIndex].flamelength, [&] (Vec2i p)
+      {
+        m.start[p.y][p.x] = std::min(m.start[p.y][p.x], t0);
+        m.end[p.y][p.x] = std::max(m.end[p.y][p.x], t1);
+      });
+  }
+}
+
+// Breadth-first search over the cells a hero can walk to without
+// getting burnt, assuming it walks at constant speed.
+template<typename State>
+struct Planner
+{
+  static constexpr int Cells = State::ROWS * State::COLS;
+
+  const State& state;
+  const DangerMap<State>& danger;
+
+  Vec2i start;
+  int ticksPerCell;
+
+  int16_t dist[State::ROWS][State::COLS]; // in cells, -1 if not reached
+  int16_t parent[Cells]; // cell index (row * COLS + col)
+  int16_t queue[Cells];
+
+  Planner(const State& state_, const DangerMap<State>& danger_) : state(state_), danger(danger_)
+  {
+  }
+
+  // Returns the reached cell with the highest positive score(cell, steps),
+  // or 'start' if there's none.
+  template<typename Score>
+  Vec2i search(Score score)
+  {
+    memset(dist, 0xff, sizeof dist);
+
+    int head = 0;
+    int tail = 0;
+
+    auto bestCell = start;
+    int bestScore = 0;
+
+    dist[start.y][start.x] = 0;
+    queue[tail++] = index(start);
+
+    while(head < tail)
+    {
+      const int i = queue[head++];
+      const Vec2i cell { i % State::COLS, i / State::COLS };
+      const int steps = dist[cell.y][cell.x];
+      const int s = score(cell, steps);
+
+      if(s > bestScore)
+      {
+        bestScore = s;
+        bestCell = cell;
+      }
+
+      if(steps >= MaxSearchSteps)
+        continue;
+
+      for(auto dir : dirs)
+      {
+        const auto next = cell + dir;
+
+        if(!isInside<State>(next) || dist[next.y][next.x] >= 0)
+          continue;
+
+        if(state.board[next.y][next.x] != 0 || danger.bombAt[next.y][next.x] >= 0)
+          continue;
+
+        // the time we're on our way out of 'cell' and into 'next'
+        const int arrival = (steps + 1) * ticksPerCell;
+
+        if(!danger.isSafeDuring(next, arrival - ticksPerCell, arrival + ticksPerCell))
+          continue;
+
+        dist[next.y][next.x] = steps + 1;
+        parent[index(next)] = i;
+        queue[tail++] = index(next);
+      }
+    }
+
+    return bestCell;
+  }
+
+  // The cell to walk to, to get to 'target'.
+  Vec2i firstStep(Vec2i target) const
+  {
+    int i = index(target);
+
+    while(i != index(start) && parent[i] != index(start))
+      i = parent[i];
+
+    return { i % State::COLS, i / State::COLS };
+  }
+
+  static int index(Vec2i p) { return p.y * State::COLS + p.x; }
+};
+
+// Walks towards the neighbouring cell 'next', or to the center of the
+// current cell. Aligns on the other axis first, so the hero fits in the corridor.
+PlayerInputState steer(Vec2f pos, Vec2i next)
+{
+  const float Tolerance = 0.1f;
+  const float dx = next.x - pos.x;
+  const float dy = next.y - pos.y;
+
+  PlayerInputState in {};
+
+  auto horizontal = [&] () { in.left = dx < 0; in.right = dx > 0; };
+  auto vertical = [&] () { in.up = dy < 0; in.down = dy > 0; };
+
+  if(fabsf(dx) <= Tolerance && fabsf(dy) <= Tolerance)
+    return in;
+
+  if(fabsf(dx) > fabsf(dy))
+  {
+    if(fabsf(dy) > Tolerance)
+      vertical();
+    else
+      horizontal();
+  }
+  else
+  {
+    if(fabsf(dx) > Tolerance)
+      horizontal();
+    else
+      vertical();
+  }
+
+  return in;
+}
+
+bool isMoving(PlayerInputState in)
+{
+  return in.left || in.right || in.up || in.down;
+}
+
+// Steps aside, to get around something 'in' didn't get us past,
+// like the corner of a bomb.
+PlayerInputState sidestep(Vec2f pos, PlayerInputState in)
+{
+  PlayerInputState r {};
+
+  if(in.left || in.right)
+  {
+    r.up = pos.y >= ::round(pos.y);
+    r.down = !r.up;
+  }
+  else
+  {
+    r.left = pos.x >= ::round(pos.x);
+    r.right = !r.left;
+  }
+
+  return r;
+}
+
+bool isGoodItem(int item)
+{
+  return item != ITEM_UNDEF && item != ITEM_DISEASE && item != ITEM_EBOLA;
+}
+
+template<typename State>
+void thinkOne(const State& state, Planner<State>& planner, int heroIdx, PlayerInputState& input, Vec2f& lastPos)
+{
+  using Line = LineMaskFor<(State::COLS > State::ROWS ? State::COLS : State::ROWS)>;
+
+  auto& h = state.heroes[heroIdx];
+  auto& danger = planner.danger;
+  const auto cell = cellOf(h.pos);
+
+  // our last move didn't get us anywhere
+  const bool stuck = isMoving(input) && h.pos == lastPos;
+  const auto prevInput = input;
+  lastPos = h.pos;
+
+  input = {};
+
+  if(!h.enable || h.dead || !isInside<State>(cell))
+    return;
+
+  const float cellsPerTick = (3.0f + h.walkspeed * 0.3f) * GamePeriodMs / 1000.0f;
+  planner.start = cell;
+  planner.ticksPerCell = (int)ceilf(1.0f / cellsPerTick);
+
+  auto goTo = [&] (Vec2i target)
+    {
+      input = steer(h.pos, target == cell ? cell : planner.firstStep(target));
+
+      if(stuck && memcmp(&input, &prevInput, sizeof input) == 0)
+        input = sidestep(h.pos, input);
+    };
+
+  // run for cover
+  if(!danger.isSafe(cell))
+  {
+    goTo(planner.search([&] (Vec2i p, int steps) { return danger.isSafe(p) ? 1000 - steps : 0; }));
+    return;
+  }
+
+  // enemies, as bitmasks, to see quickly which cells are in line with them
+  Line enemyRows[State::ROWS] {};
+  Line enemyCols[State::COLS] {};
+
+  for(auto& other : state.heroes)
+  {
+    const auto p = cellOf(other.pos);
+
+    if(&other == &h || !other.enable || other.dead || !isInside<State>(p))
+      continue;
+
+    enemyRows[p.y] |= Line(1) << p.x;
+    enemyCols[p.x] |= Line(1) << p.y;
+  }
+
+  const int reach = h.flamelength;
+
+  // bits [center - reach, center + reach]
+  auto around = [&] (int center) -> uint64_t
+    {
+      const int lo = std::max(center - reach, 0);
+      const int hi = std::min(center + reach, 63);
+      return (~0ull >> (63 - hi)) & (~0ull << lo);
+    };
+
+  // How much a bomb dropped at 'p' would achieve
+  auto bombValue = [&] (Vec2i p)
+    {
+      int value = 0;
+
+      if((enemyRows[p.y] & around(p.x)) || (enemyCols[p.x] & around(p.y)))
+        value += 3;
+
+      for(auto dir : dirs)
+      {
+        const auto q = p + dir;
+
+        if(isInside<State>(q) && state.board[q.y][q.x] == 2)
+          value++;
+      }
+
+      return value;
+    };
+
+  // Is there somewhere to hide from a bomb dropped here?
+  auto canEscape = [&] ()
+    {
+      bool inRays[State::ROWS][State::COLS] {};
+      forEachFlameCell(state, cell, h.flamelength, [&] (Vec2i p) { inRays[p.y][p.x] = true; });
+
+      auto hideout = planner.search([&] (Vec2i p, int steps)
+          {
+            const bool inTime = (steps + 1) * planner.ticksPerCell + Margin < FuseTicks;
+            return inTime && danger.isSafe(p) && !inRays[p.y][p.x] ? 1000 - steps : 0;
+          });
+
+      return !(hideout == cell);
+    };
+
+  const bool canDrop = danger.ownerCount[heroIdx] < h.maxbombs;
+  bool stuckHere = false; // nothing to do where we are
+
+  if(canDrop && danger.bombAt[cell.y][cell.x] < 0 && bombValue(cell) > 0)
+  {
+    if(canEscape())
+    {
+      input.dropBomb = true;
+      return;
+    }
+
+    stuckHere = true;
+  }
+
+  // head for the closest interesting cell
+  auto target = planner.search([&] (Vec2i p, int steps)
+      {
+        if(!danger.isSafe(p))
+          return 0;
+
+        int value = isGoodItem(state.items[p.y][p.x]) ? 3 : 0;
+
+        // no use going there if we can't drop a bomb
+        if(canDrop && !(stuckHere && p == cell))
+          value += bombValue(p);
+
+        return value ? value * 4 + MaxSearchSteps - steps : 0;
+      });
+
+  goTo(target);
+}
+}
+
+template<typename State>
+int BotTeam<State>::think(const State& state, uint64_t botMask, PlayerInputState inputs[State::MAX_HEROES], int64_t budgetNs)
+{
+  if(!botMask)
+    return 0;
+
+  const int64_t t0 = getMonotonicTimeNs();
+
+  DangerMap<State> danger;
+  buildDangerMap(danger, state);
+
+  Planner<State> planner(state, danger);
+
+  int count = 0;
+
+  for(int k = 0; k < State::MAX_HEROES; ++k)
+  {
+    const int i = (m_nextBot + k) % State::MAX_HEROES;
+
+    if(!((botMask >> i) & 1))
+      continue;
+
+    // at least one bot thinks on each tick, so they all get their turn
+    if(count > 0 && getMonotonicTimeNs() - t0 > budgetNs)
+    {
+      m_nextBot = i;
+      return count;
+    }
+
+    thinkOne(state, planner, i, inputs[i], m_lastPos[i]);
+    ++count;
+  }
+
+  return count;
+}
+
+template struct BotTeam<GameLogicState>;
+template struct BotTeam<GameLogicState31x21>;
+template struct BotTeam<GameLogicState63x63>;
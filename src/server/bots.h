@@ -0,0 +1,24 @@
+// Built-in players, for the hero slots no remote player controls.
+// A bot only looks at the state, and produces the same PlayerInputState
+// a remote player would send, so the simulation doesn't know about them.
+#pragma once
+
+#include <cstdint>
+
+#include "gamelogic.h"
+
+// The bots of one match.
+// Thinking is bounded in time: the bots that don't get to think during a
+// tick keep their previous inputs, and get served first on the next one.
+// Instantiated for each MapPreset.
+template<typename State>
+struct BotTeam
+{
+  // Updates inputs[i] for the heroes whose bit 'i' is set in 'botMask'.
+  // Returns the number of bots that got to think.
+  int think(const State& state, uint64_t botMask, PlayerInputState inputs[State::MAX_HEROES], int64_t budgetNs);
+
+private:
+  int m_nextBot = 0; // round-robin, so a tight budget is shared fairly
+  Vec2f m_lastPos[State::MAX_HEROES] {}; // where each bot was when it last thought
+};
@@ -0,0 +1,327 @@
+#include "demo.h"
+
+#include <cstring> // memcpy, memcmp
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace
+{
+const uint32_t Magic = 0x4D444C42; // "BLDM"
+const uint32_t Version = 3;
+
+enum RecordTag : uint8_t
+{
+  TagReset = 1,
+  TagCheckpoint = 2,
+  TagTick = 3,
+};
+
+// The states in the keyframes are raw copies: the demo must be replayed by
+// the same build. Of the match, the keyframes only store what the simulation
+// can't derive from the state; the caches are rebuilt on load.
+struct FileHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t preset;
+  uint32_t stateSize;
+};
+
+static_assert(std::is_trivially_copyable<GameLogicState>::value);
+
+// Flags of a keyframe
+enum : uint8_t
+{
+  FlagInstantChains = 1,
+  FlagFixedPoint = 2,
+};
+
+template<int MaxHeroes>
+constexpr int tickSize()
+{
+  return (MaxHeroes * PackedInputBits + 7) / 8;
+}
+
+// The packInput() bits of each hero, back to back
+template<int MaxHeroes>
+void packInputs(const PlayerInputState inputs[MaxHeroes], uint8_t out[tickSize<MaxHeroes>()])
+{
+  memset(out, 0, tickSize<MaxHeroes>());
+
+  for(int i = 0; i < MaxHeroes; ++i)
+  {
+    const uint8_t bits = packInput(inputs[i]);
+
+    for(int k = 0; k < PackedInputBits; ++k)
+    {
+      const int bitPos = i * PackedInputBits + k;
+
+      if((bits >> k) & 1)
+        out[bitPos / 8] |= 1 << (bitPos % 8);
+    }
+  }
+}
+
+template<int MaxHeroes>
+void unpackInputs(const uint8_t in[tickSize<MaxHeroes>()], PlayerInputState inputs[MaxHeroes])
+{
+  for(int i = 0; i < MaxHeroes; ++i)
+  {
+    uint8_t bits = 0;
+
+    for(int k = 0; k < PackedInputBits; ++k)
+    {
+      const int bitPos = i * PackedInputBits + k;
+
+      if(in[bitPos / 8] & (1 << (bitPos % 8)))
+        bits |= 1 << k;
+    }
+
+    inputs[i] = unpackInput(bits);
+  }
+}
+
+bool sameHero(const HeroState& a, const HeroState& b)
+{
+  return a.pos == b.pos
+         && a.upgrades == b.upgrades
+         && a.flamelength == b.flamelength
+         && a.walkspeed == b.walkspeed
+         && a.maxbombs == b.maxbombs
+         && a.orientation == b.orientation
+         && a.dead == b.dead
+         && a.enable == b.enable
+         && a.isHoldingBomb == b.isHoldingBomb;
+}
+
+bool sameBomb(const BombState& a, const BombState& b)
+{
+  return a.pos == b.pos
+         && a.vel == b.vel
+         && a.countdown == b.countdown
+         && a.ownerIndex == b.ownerIndex
+         && a.jelly == b.jelly;
+}
+
+template<typename State>
+bool sameState(const State& a, const State& b)
+{
+  if(memcmp(a.board, b.board, sizeof a.board) || memcmp(a.items, b.items, sizeof a.items))
+    return false;
+
+  for(int i = 0; i < State::MAX_HEROES; ++i)
+    if(!sameHero(a.heroes[i], b.heroes[i]))
+      return false;
+
+  if(memcmp(a.bombs.live, b.bombs.live, sizeof a.bombs.live))
+    return false;
+
+  for(int i = a.bombs.next(-1); i >= 0; i = a.bombs.next(i))
+    if(!sameBomb(a.bombs[i], b.bombs[i]))
+      return false;
+
+  return true;
+}
+
+FileHeader readHeader(const MappedFile& file, const char* path)
+{
+  auto data = file.data();
+
+  FileHeader hdr {};
+
+  if(data.len >= (int)sizeof hdr)
+    memcpy(&hdr, data.data, sizeof hdr);
+
+  if(hdr.magic != Magic)
+    throw std::runtime_error("Not a demo file: '" + std::string(path) + "'");
+
+  if(hdr.version != Version || hdr.preset >= (uint32_t)MapPreset::Count)
+    throw std::runtime_error("Demo file was recorded by an incompatible build: '" + std::string(path) + "'");
+
+  return hdr;
+}
+
+template<typename State>
+DemoReplayResult replay(const char* path)
+{
+  using Reader = BasicDemoReader<State>;
+
+  DemoReplayResult r;
+  Reader reader(path);
+
+  BasicGameMatch<State> match;
+  State state {};
+
+  for(;;)
+  {
+    switch(reader.next())
+    {
+    case Reader::End:
+      return r;
+    case Reader::Checkpoint:
+      r.checkpoints++;
+
+      // also checks the incremental board hash against a full rehash
+      if(!sameState(reader.state, state) || reader.match.rng.state != match.rng.state || reader.match.intergameTimer != match.intergameTimer
+         || match.boardHash != hashBoard(state))
+      {
+        printf("Replay diverged at tick %d\n", r.ticks);
+        r.mismatches++;
+      }
+
+      // resynchronize
+      [[fallthrough]];
+    case Reader::Reset:
+      match = reader.match;
+      match.checkCaches = true;
+      state = reader.state;
+      break;
+    case Reader::Tick:
+      state = advanceGameLogic(match, state, reader.inputs);
+      r.ticks++;
+      break;
+    }
+  }
+}
+}
+
+template<typename State>
+BasicDemoWriter<State>::BasicDemoWriter(const char* path, int checkpointPeriod)
+  : m_checkpointPeriod(checkpointPeriod)
+{
+  m_fp = fopen(path, "wb");
+
+  if(!m_fp)
+    throw std::runtime_error("Could not create demo file '" + std::string(path) + "'");
+
+  const FileHeader hdr { Magic, Version, (uint32_t)State::PRESET, sizeof(State) };
+  fwrite(&hdr, sizeof hdr, 1, m_fp);
+}
+
+template<typename State>
+BasicDemoWriter<State>::~BasicDemoWriter()
+{
+  fclose(m_fp);
+}
+
+template<typename State>
+void BasicDemoWriter<State>::writeTick(const GameMatch& match, const State& state, const PlayerInputState inputs[State::MAX_HEROES], bool isReset)
+{
+  if(isReset || m_empty)
+    writeKeyframe(match, state, true);
+  else if(m_ticksSinceKeyframe >= m_checkpointPeriod)
+    writeKeyframe(match, state, false);
+
+  uint8_t packed[tickSize<State::MAX_HEROES>()];
+  packInputs<State::MAX_HEROES>(inputs, packed);
+
+  fputc(TagTick, m_fp);
+  fwrite(packed, sizeof packed, 1, m_fp);
+  ++m_ticksSinceKeyframe;
+}
+
+template<typename State>
+void BasicDemoWriter<State>::writeKeyframe(const GameMatch& match, const State& state, bool isReset)
+{
+  const uint8_t flags = (match.instantChains ? FlagInstantChains : 0) | (match.fixedPoint ? FlagFixedPoint : 0);
+  const int32_t intergameTimer = match.intergameTimer;
+  uint8_t lastInputs[tickSize<State::MAX_HEROES>()];
+  packInputs<State::MAX_HEROES>(match.lastInputs, lastInputs);
+
+  fputc(isReset ? TagReset : TagCheckpoint, m_fp);
+  fwrite(&match.rng.state, sizeof match.rng.state, 1, m_fp);
+  fwrite(&match.boardHash, sizeof match.boardHash, 1, m_fp);
+  fwrite(&intergameTimer, sizeof intergameTimer, 1, m_fp);
+  fputc(flags, m_fp);
+  fwrite(lastInputs, sizeof lastInputs, 1, m_fp);
+  fwrite(&state, sizeof state, 1, m_fp);
+  m_ticksSinceKeyframe = 0;
+  m_empty = false;
+}
+
+template<typename State>
+BasicDemoReader<State>::BasicDemoReader(const char* path) : m_file(path)
+{
+  const auto hdr = readHeader(m_file, path);
+
+  if(hdr.preset != (uint32_t)State::PRESET || hdr.stateSize != sizeof(State))
+    throw std::runtime_error("Demo file was recorded by an incompatible build: '" + std::string(path) + "'");
+
+  m_pos = sizeof hdr;
+}
+
+template<typename State>
+typename BasicDemoReader<State>::Record BasicDemoReader<State>::next()
+{
+  auto data = m_file.data();
+
+  if(m_pos >= data.len)
+    return End;
+
+  const uint8_t tag = data[m_pos++];
+
+  auto fetch = [&] (void* dst, int size)
+    {
+      if(m_pos + size > data.len)
+        throw std::runtime_error("Truncated demo file");
+
+      memcpy(dst, data.data + m_pos, size);
+      m_pos += size;
+    };
+
+  switch(tag)
+  {
+  case TagReset:
+  case TagCheckpoint:
+    {
+      int32_t intergameTimer;
+      uint8_t flags;
+      uint8_t lastInputs[tickSize<State::MAX_HEROES>()];
+
+      fetch(&match.rng.state, sizeof match.rng.state);
+      fetch(&match.boardHash, sizeof match.boardHash);
+      fetch(&intergameTimer, sizeof intergameTimer);
+      fetch(&flags, sizeof flags);
+      fetch(lastInputs, sizeof lastInputs);
+      fetch(&state, sizeof state);
+
+      match.intergameTimer = intergameTimer;
+      match.instantChains = flags & FlagInstantChains;
+      match.fixedPoint = flags & FlagFixedPoint;
+      unpackInputs<State::MAX_HEROES>(lastInputs, match.lastInputs);
+      rebuildMatchCaches(match, state);
+      return tag == TagReset ? Reset : Checkpoint;
+    }
+  case TagTick:
+    {
+      uint8_t packed[tickSize<State::MAX_HEROES>()];
+      fetch(packed, sizeof packed);
+      unpackInputs<State::MAX_HEROES>(packed, inputs);
+      return Tick;
+    }
+  default:
+    throw std::runtime_error("Corrupted demo file (tag=" + std::to_string(tag) + ")");
+  }
+}
+
+MapPreset readDemoPreset(const char* path)
+{
+  MappedFile file(path);
+  return (MapPreset)readHeader(file, path).preset;
+}
+
+DemoReplayResult replayDemo(const char* path)
+{
+  DemoReplayResult r;
+  visitPreset(readDemoPreset(path), [&] (auto tag) { r = replay<typename decltype(tag)::type>(path); });
+  return r;
+}
+
+template struct BasicDemoWriter<GameLogicState>;
+template struct BasicDemoWriter<GameLogicState31x21>;
+template struct BasicDemoWriter<GameLogicState63x63>;
+
+template struct BasicDemoReader<GameLogicState>;
+template struct BasicDemoReader<GameLogicState31x21>;
+template struct BasicDemoReader<GameLogicState63x63>;
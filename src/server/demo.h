@@ -0,0 +1,80 @@
+// Demo files: a match recorded as its per-tick inputs, plus keyframes.
+// The simulation is deterministic, so replaying the inputs from a keyframe
+// reproduces the match, which makes demos much smaller than snapshots.
+//
+// There are two kinds of keyframes:
+// - reset keyframes, written when the state was changed by something else
+//   than the simulation (new match, player joining, restart...);
+// - checkpoints, written periodically: they allow seeking, and replays
+//   can check that they reach the same state.
+#pragma once
+
+#include <cstdio>
+#include <memory>
+
+#include "gamelogic.h"
+#include "mapped_file.h"
+
+// Instantiated for each MapPreset.
+template<typename State>
+struct BasicDemoWriter
+{
+  using GameMatch = BasicGameMatch<State>;
+
+  BasicDemoWriter(const char* path, int checkpointPeriod = 400);
+  ~BasicDemoWriter();
+
+  // Records the inputs of the next tick.
+  // The state and match must be the ones about to be simulated.
+  // 'isReset' means that they changed since the last tick by other means
+  // than the simulation.
+  void writeTick(const GameMatch& match, const State& state, const PlayerInputState inputs[State::MAX_HEROES], bool isReset);
+
+private:
+  void writeKeyframe(const GameMatch& match, const State& state, bool isReset);
+
+  FILE* m_fp;
+  const int m_checkpointPeriod;
+  int m_ticksSinceKeyframe = 0;
+  bool m_empty = true;
+};
+
+template<typename State>
+struct BasicDemoReader
+{
+  BasicDemoReader(const char* path);
+
+  enum Record
+  {
+    End,
+    Reset, // 'match' and 'state' were updated
+    Checkpoint, // 'match' and 'state' were updated
+    Tick, // 'inputs' were updated
+  };
+
+  Record next();
+
+  BasicGameMatch<State> match;
+  State state;
+  PlayerInputState inputs[State::MAX_HEROES];
+
+private:
+  MappedFile m_file;
+  int m_pos;
+};
+
+using DemoWriter = BasicDemoWriter<GameLogicState>;
+using DemoReader = BasicDemoReader<GameLogicState>;
+
+// The preset the demo was recorded with.
+MapPreset readDemoPreset(const char* path);
+
+struct DemoReplayResult
+{
+  int ticks = 0;
+  int checkpoints = 0;
+  int mismatches = 0; // checkpoints not reached by the replay
+};
+
+// Reruns the simulation over the recorded inputs.
+DemoReplayResult replayDemo(const char* path);
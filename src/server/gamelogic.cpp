@@ -1,138 +1,289 @@
-#include "game.h"
+#include "gamelogic.h"
+#include "clock.h"
 #include "protocol.h" // GamePeriodMs
+#include "state_hash.h"
+#include <algorithm> // min
 #include <cmath>
-#include <cstring> // memcpy
+#include <cstring> // memcpy, memcmp
+#include <stdexcept>
 
 namespace
 {
-// server-only state
-PlayerInputState lastInputs[MAX_HEROES];
-int intergameTimer = 0;
+// Rebuilds the masks if the board changed since the last call.
+template<typename State>
+BoardMasks<State>& syncBoardMasks(BoardMasks<State>& r, const State& state)
+{
+  using Line = typename BoardMasks<State>::Line;
+
+  if(r.valid && memcmp(r.board, state.board, sizeof r.board) == 0)
+    return r;
+
+  r.valid = true;
+  r.generation++;
+  memcpy(r.board, state.board, sizeof r.board);
+
+  for(int row = 0; row < state.ROWS; ++row)
+  {
+    Line traversable = 0;
+    Line destroyable = 0;
 
-struct FlameCoverage
+    for(int col = 0; col < state.COLS; ++col)
+    {
+      traversable |= Line(state.board[row][col] == 0) << col;
+      destroyable |= Line(state.board[row][col] == 2) << col;
+    }
+
+    r.traversableRows[row] = traversable;
+    r.destroyableRows[row] = destroyable;
+  }
+
+  // transpose
+  for(int col = 0; col < state.COLS; ++col)
+  {
+    Line traversable = 0;
+    Line destroyable = 0;
+
+    for(int row = 0; row < state.ROWS; ++row)
+    {
+      traversable |= Line((r.traversableRows[row] >> col) & 1) << row;
+      destroyable |= Line((r.destroyableRows[row] >> col) & 1) << row;
+    }
+
+    r.traversableCols[col] = traversable;
+    r.destroyableCols[col] = destroyable;
+  }
+
+  return r;
+}
+
+template<typename State>
+void destroyBrick(State& state, BoardMasks<State>& board, uint64_t& boardHash, int row, int col)
 {
-  bool inflames[GameLogicState::ROWS][GameLogicState::COLS] {};
-};
+  using Line = typename BoardMasks<State>::Line;
+
+  const int index = row * State::COLS + col;
+  const int item = state.items[row][col];
+  boardHash ^= cellHash(index, state.board[row][col], item) ^ cellHash(index, 0, item);
+
+  state.board[row][col] = 0;
+  board.board[row][col] = 0;
+  board.generation++;
+  board.traversableRows[row] |= Line(1) << col;
+  board.traversableCols[col] |= Line(1) << row;
+  board.destroyableRows[row] &= ~(Line(1) << col);
+  board.destroyableCols[col] &= ~(Line(1) << row);
+}
+
+// Number of consecutive set bits in 'line', starting from bit 'start'
+// and going towards the higher bits (dir > 0), or the lower bits (dir < 0).
+int countRun(uint64_t line, int start, int dir)
+{
+  if(dir > 0)
+    return __builtin_ctzll(~(line >> start));
+  else
+    return __builtin_clzll(~(line << (63 - start)));
+}
 
 Vec2i round(Vec2f v)
 {
   return Vec2i{ (int)::round(v.x), (int)::round(v.y) };
 }
 
-GameLogicState::Bomb* findBombAt(GameLogicState& state, Vec2i pos)
+Vec2i round(Vec2x v)
 {
-  for(auto& b : state.bombs)
-    if(b.enable && round(b.pos) == pos)
-      return &b;
+  return Vec2i{ v.x.round(), v.y.round() };
+}
+
+// The movement code is written once for both simulation modes:
+// Vec2f (floating point), and Vec2x (fixed point).
+// The state always stores Vec2f. In fixed-point mode, it only holds values
+// on the fixed-point grid, so loading and storing them is lossless, and
+// rounding them gives the same result in both modes.
+template<typename V>
+V load(Vec2f v);
 
-  return nullptr;
+template<>
+Vec2f load<Vec2f>(Vec2f v)
+{
+  return v;
 }
 
-GameLogicState::Bomb* allocBomb(GameLogicState& state)
+template<>
+Vec2x load<Vec2x>(Vec2f v)
 {
-  for(auto& b : state.bombs)
-    if(!b.enable)
-    {
-      b = {};
-      return &b;
-    }
+  return Vec2x::fromFloat(v);
+}
 
-  return nullptr;
+Vec2f store(Vec2f v)
+{
+  return v;
 }
 
-bool isInside(const GameLogicState& state, int row, int col)
+Vec2f store(Vec2x v)
 {
-  if(row < 0 || row >= state.ROWS)
-    return false;
+  return v.toFloat();
+}
 
-  if(col < 0 || col >= state.COLS)
-    return false;
+template<typename State>
+bool isInside(int row, int col)
+{
+  return unsigned(row) < unsigned(State::ROWS) && unsigned(col) < unsigned(State::COLS);
+}
 
-  return true;
+template<typename State>
+BombIndex<State> buildBombIndex(const State& state)
+{
+  BombIndex<State> r;
+
+  for(int i = state.bombs.next(-1); i >= 0; i = state.bombs.next(i))
+  {
+    auto& b = state.bombs[i];
+    r.add(i, round(b.pos));
+    r.ownerCount[b.ownerIndex]++;
+  }
+
+  return r;
 }
 
-bool isTraversable(const GameLogicState& state, int row, int col)
+template<typename State>
+BombState* findBombAt(State& state, const BombIndex<State>& bombs, Vec2i pos)
 {
-  return isInside(state, row, col) && state.board[row][col] == 0;
+  if(!isInside<State>(pos.y, pos.x) || bombs.head[pos.y][pos.x] == BombIndex<State>::None)
+    return nullptr;
+
+  return &state.bombs[bombs.head[pos.y][pos.x]];
 }
 
-bool isDestroyable(const GameLogicState& state, int row, int col)
+template<typename State>
+bool sameBombIndex(const BombIndex<State>& a, const BombIndex<State>& b, const State& state)
 {
-  return isInside(state, row, col) && state.board[row][col] == 2;
+  if(memcmp(a.head, b.head, sizeof a.head) || memcmp(a.occupiedRows, b.occupiedRows, sizeof a.occupiedRows)
+     || memcmp(a.ownerCount, b.ownerCount, sizeof a.ownerCount))
+    return false;
+
+  // the links of the free slots are stale
+  for(int i = state.bombs.next(-1); i >= 0; i = state.bombs.next(i))
+  {
+    if(a.next[i] != b.next[i])
+      return false;
+  }
+
+  return true;
 }
 
-bool isTraversable(const GameLogicState& state, Vec2i pos)
+template<typename State>
+bool isTraversable(const BoardMasks<State>& board, int row, int col)
 {
-  return isTraversable(state, pos.y, pos.x);
+  return isInside<State>(row, col) && ((board.traversableRows[row] >> col) & 1);
 }
 
-bool isTraversable(const GameLogicState& state, Vec2f pos)
+template<typename State>
+bool isDestroyable(const BoardMasks<State>& board, int row, int col)
 {
-  return isTraversable(state, round(pos));
+  return isInside<State>(row, col) && ((board.destroyableRows[row] >> col) & 1);
 }
 
-bool isDestroyable(const GameLogicState& state, Vec2i pos)
+template<typename State, typename V>
+bool isTraversable(const BoardMasks<State>& board, V pos)
 {
-  return isDestroyable(state, pos.y, pos.x);
+  const auto p = round(pos);
+  return isTraversable(board, p.y, p.x);
 }
 
-float sqrLen(Vec2f v)
+template<typename V>
+typename V::Scalar sqrLen(V v)
 {
   return v * v;
 }
 
-int scan(const GameLogicState& state, Vec2i pos, Vec2i dir, int maxSteps)
+const Vec2i flameDirs[4] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+// Number of traversable cells, starting from 'pos' (included) and going in the
+// direction 'dir', stopping after 'maxSteps + 1' cells.
+template<typename State>
+int scan(const BoardMasks<State>& board, Vec2i pos, Vec2i dir, int maxSteps)
 {
-  int r = 0;
+  if(!isInside<State>(pos.y, pos.x))
+    return 0;
 
-  while(maxSteps >= 0 && isTraversable(state, pos))
-  {
-    pos = pos + dir;
-    --maxSteps;
-    ++r;
-  }
+  int n;
 
-  return r;
+  if(dir.y == 0)
+    n = countRun(board.traversableRows[pos.y], pos.x, dir.x);
+  else
+    n = countRun(board.traversableCols[pos.x], pos.y, dir.y);
+
+  return std::min(n, maxSteps + 1);
 }
 
-bool isRectColliding(const GameLogicState& state, Vec2f pos, Vec2f size)
+template<typename State, typename V>
+bool isRectColliding(const BoardMasks<State>& board, V pos, V size)
 {
-  if(!isTraversable(state, pos))
+  using S = typename V::Scalar;
+
+  if(!isTraversable(board, pos))
     return true;
 
-  if(!isTraversable(state, pos + Vec2f(size.x, 0)))
+  if(!isTraversable(board, pos + V(size.x, S(0))))
     return true;
 
-  if(!isTraversable(state, pos + Vec2f(0, size.y)))
+  if(!isTraversable(board, pos + V(S(0), size.y)))
     return true;
 
-  if(!isTraversable(state, pos + size))
+  if(!isTraversable(board, pos + size))
     return true;
 
   return false;
 }
 
-float sign(float f)
-{ return f ? (f < 0 ? -1.0f : +1.0f) : 0.0f; }
+template<typename S>
+S sign(S f)
+{ return f ? (f < S(0) ? S(-1) : S(+1)) : S(0); }
 
-bool directMove(const GameLogicState& state, Vec2f& pos, Vec2f size, Vec2f delta)
+// 'ignoredBomb' is the index of the bomb being moved, if any.
+template<typename State, typename V>
+bool directMove(const State& state, const BoardMasks<State>& board, const BombIndex<State>& bombs, V& pos, V size, V delta, int ignoredBomb = BombIndex<State>::None)
 {
+  using S = typename V::Scalar;
+
   auto newPos = pos + delta;
 
-  if(isRectColliding(state, newPos - size * 0.5, size))
+  if(isRectColliding(board, newPos - size * S(0.5), size))
     return false;
 
-  for(auto& b : state.bombs)
+  // a bomb closer than 1 cell from 'newPos' is indexed in one of the 3x3 cells around it
+  const auto cell = round(newPos);
+
+  for(int row = cell.y - 1; row <= cell.y + 1; ++row)
   {
-    if(b.enable)
+    if(unsigned(row) >= unsigned(State::ROWS))
+      continue;
+
+    // bits [cell.x - 1, cell.x + 1]
+    const uint64_t around = (uint64_t(7) << std::max(cell.x, 0)) >> 1;
+
+    if(!(bombs.occupiedRows[row] & around))
+      continue;
+
+    for(int col = cell.x - 1; col <= cell.x + 1; ++col)
     {
-      auto newDist = sqrLen(b.pos - newPos);
+      if(!isInside<State>(row, col))
+        continue;
+
+      for(int i = bombs.head[row][col]; i != BombIndex<State>::None; i = bombs.next[i])
+      {
+        if(i == ignoredBomb)
+          continue;
+
+        const auto bombPos = load<V>(state.bombs[i].pos);
+        auto newDist = sqrLen(bombPos - newPos);
 
-      if(newDist < 1.0 && sqrLen(b.pos - pos) >= 1.0)
-        return false;
+        if(newDist < S(1.0) && sqrLen(bombPos - pos) >= S(1.0))
+          return false;
 
-      if(newDist < 0.5 && sqrLen(b.pos - pos) >= 0.5)
-        return false;
+        if(newDist < S(0.5) && sqrLen(bombPos - pos) >= S(0.5))
+          return false;
+      }
     }
   }
 
@@ -140,9 +291,14 @@ bool directMove(const GameLogicState& state, Vec2f& pos, Vec2f size, Vec2f delta
   return true;
 }
 
-void pickupItem(GameLogicState& state, GameLogicState::Hero& h, Vec2i roundPos)
+template<typename State>
+void pickupItem(State& state, uint64_t& boardHash, HeroState& h, Vec2i roundPos)
 {
   const int itemType = state.items[roundPos.y][roundPos.x];
+  const int index = roundPos.y * State::COLS + roundPos.x;
+  const int cell = state.board[roundPos.y][roundPos.x];
+  boardHash ^= cellHash(index, cell, itemType) ^ cellHash(index, cell, 0);
+
   switch(itemType)
   {
   case ITEM_DISEASE:
@@ -182,106 +338,131 @@ void pickupItem(GameLogicState& state, GameLogicState::Hero& h, Vec2i roundPos)
   state.items[roundPos.y][roundPos.x] = 0;
 }
 
-void updateHeroes(GameLogicState& state, const FlameCoverage& flames, PlayerInputState inputs[MAX_HEROES])
+// Type of the hero speeds. The floating point mode keeps them in double,
+// and rounds the velocities from there, as it always did: games recorded
+// before the fixed-point mode still replay the same.
+template<typename S>
+struct SpeedFor { using type = S; };
+
+template<>
+struct SpeedFor<float> { using type = double; };
+
+// Hero walking speed, in cells per second
+template<typename S>
+typename SpeedFor<S>::type walkSpeed(int walkspeed)
 {
-  auto activeBombCount = [&] (int heroIdx)
-    {
-      int r = 0;
+  using T = typename SpeedFor<S>::type;
 
-      for(auto& b : state.bombs)
-        if(b.enable && b.ownerIndex == heroIdx)
-          r++;
+  // computed at compile time, so they don't depend on the floating point environment
+  static constexpr T speeds[16] =
+  {
+    T(3.0 + 0 * 0.3), T(3.0 + 1 * 0.3), T(3.0 + 2 * 0.3), T(3.0 + 3 * 0.3),
+    T(3.0 + 4 * 0.3), T(3.0 + 5 * 0.3), T(3.0 + 6 * 0.3), T(3.0 + 7 * 0.3),
+    T(3.0 + 8 * 0.3), T(3.0 + 9 * 0.3), T(3.0 + 10 * 0.3), T(3.0 + 11 * 0.3),
+    T(3.0 + 12 * 0.3), T(3.0 + 13 * 0.3), T(3.0 + 14 * 0.3), T(3.0 + 15 * 0.3),
+  };
 
-      return r;
-    };
+  return speeds[walkspeed];
+}
+
+// Moves a hero by one tick of 'input'. Walls and bombs block it, it slides
+// around the corners it bumps into, and it kicks the bombs it walks into.
+template<typename V, typename State>
+void moveHero(State& state, const BoardMasks<State>& board, const BombIndex<State>& bombs, HeroState& h, PlayerInputState input)
+{
+  using S = typename V::Scalar;
 
-  auto pushMove = [&] (GameLogicState::Hero& h, Vec2f size, Vec2f delta) -> bool
+  auto pushMove = [&] (V& pos, V size, V delta) -> bool
     {
-      auto blocked = !directMove(state, h.pos, size, delta);
+      auto blocked = !directMove(state, board, bombs, pos, size, delta);
 
       if(blocked && (h.upgrades & UPGRADE_KICK))
       {
-        auto orthonormalize = [] (Vec2f v)
+        auto orthonormalize = [] (V v)
           {
-            return Vec2f{ sign(v.x), sign(v.y) };
+            return V{ sign(v.x), sign(v.y) };
           };
 
         auto orthoDelta = orthonormalize(delta);
 
-        if(auto bomb = findBombAt(state, round(h.pos + delta + orthoDelta * 0.5)))
-          bomb->vel = orthoDelta * 0.3;
+        if(auto bomb = findBombAt(state, bombs, round(pos + delta + orthoDelta * S(0.5))))
+          bomb->vel = store(orthoDelta * S(0.3));
       }
 
       return !blocked;
     };
 
-  auto moveHero = [&] (GameLogicState::Hero& h, PlayerInputState input)
-    {
-      auto speed = 3.0 + h.walkspeed * 0.3;
+  const auto speed = walkSpeed<S>(h.walkspeed);
 
-      Vec2f vel = Vec2f::zero();
+  V vel = V::zero();
 
-      if(input.left)
-        vel.x -= speed;
+  if(input.left)
+    vel.x -= speed;
 
-      if(input.right)
-        vel.x += speed;
+  if(input.right)
+    vel.x += speed;
 
-      if(input.up)
-        vel.y -= speed;
+  if(input.up)
+    vel.y -= speed;
 
-      if(input.down)
-        vel.y += speed;
+  if(input.down)
+    vel.y += speed;
 
-      auto dt = (GamePeriodMs / 1000.0f);
-      auto delta = vel * dt;
-      auto size = Vec2f(1, 1) * 0.7;
+  const S dt = S(GamePeriodMs / 1000.0f);
+  auto delta = vel * dt;
+  auto size = V(S(1), S(1)) * S(0.7);
+  auto pos = load<V>(h.pos);
 
-      if(delta.x)
+  if(delta.x)
+  {
+    if(!pushMove(pos, size, V(delta.x, S(0))))
+    {
+      if(delta.y == S(0))
       {
-        if(!pushMove(h, size, Vec2f(delta.x, 0)))
-        {
-          if(delta.y == 0)
-          {
-            auto topPos = h.pos + Vec2f(delta.x, 0) + Vec2f(sign(delta.x) * 0.5, -0.6);
-            auto botPos = h.pos + Vec2f(delta.x, 0) + Vec2f(sign(delta.x) * 0.5, +0.6);
-            bool topClear = isTraversable(state, topPos);
-            bool botClear = isTraversable(state, botPos);
+        auto topPos = pos + V(delta.x, S(0)) + V(sign(delta.x) * S(0.5), S(-0.6));
+        auto botPos = pos + V(delta.x, S(0)) + V(sign(delta.x) * S(0.5), S(+0.6));
+        bool topClear = isTraversable(board, topPos);
+        bool botClear = isTraversable(board, botPos);
 
-            if(topClear || botClear)
-            {
-              auto dy = botClear ? 1 : -1;
-              pushMove(h, size, Vec2f(0, speed * dy * dt));
-            }
-          }
+        if(topClear || botClear)
+        {
+          auto dy = botClear ? 1 : -1;
+          pushMove(pos, size, V(S(0), S(speed * dy * dt)));
         }
-
-        h.orientation = delta.x > 0 ? 0 : 2;
       }
+    }
 
-      if(delta.y)
+    h.orientation = delta.x > S(0) ? 0 : 2;
+  }
+
+  if(delta.y)
+  {
+    if(!pushMove(pos, size, V(S(0), delta.y)))
+    {
+      if(delta.x == S(0))
       {
-        if(!pushMove(h, size, Vec2f(0, delta.y)))
-        {
-          if(delta.x == 0)
-          {
-            auto topPos = h.pos + Vec2f(0, delta.y) + Vec2f(-0.6, sign(delta.y) * 0.5);
-            auto botPos = h.pos + Vec2f(0, delta.y) + Vec2f(+0.6, sign(delta.y) * 0.5);
-            bool topClear = isTraversable(state, topPos);
-            bool botClear = isTraversable(state, botPos);
+        auto topPos = pos + V(S(0), delta.y) + V(S(-0.6), sign(delta.y) * S(0.5));
+        auto botPos = pos + V(S(0), delta.y) + V(S(+0.6), sign(delta.y) * S(0.5));
+        bool topClear = isTraversable(board, topPos);
+        bool botClear = isTraversable(board, botPos);
 
-            if(topClear || botClear)
-            {
-              auto dx = botClear ? 1 : -1;
-              pushMove(h, size, Vec2f(speed * dx * dt, 0));
-            }
-          }
+        if(topClear || botClear)
+        {
+          auto dx = botClear ? 1 : -1;
+          pushMove(pos, size, V(S(speed * dx * dt), S(0)));
         }
-
-        h.orientation = delta.y > 0 ? 1 : 3;
       }
-    };
+    }
+
+    h.orientation = delta.y > S(0) ? 1 : 3;
+  }
 
+  h.pos = store(pos);
+}
+
+template<typename V, typename State>
+void updateHeroes(BasicGameMatch<State>& match, State& state, const BoardMasks<State>& board, BombIndex<State>& bombs, FlameMap<State>& flames, PlayerInputState inputs[State::MAX_HEROES])
+{
   int survivorCount = 0;
 
   for(auto& h : state.heroes)
@@ -293,57 +474,123 @@ void updateHeroes(GameLogicState& state, const FlameCoverage& flames, PlayerInpu
 
     const int idx = int(&h - state.heroes);
     const auto& input = inputs[idx];
-    const auto& prevInput = lastInputs[idx];
+    const auto& prevInput = match.lastInputs[idx];
 
     auto roundPos = round(h.pos);
 
-    pickupItem(state, h, roundPos);
+    const int flamelength = h.flamelength;
+    pickupItem(state, match.boardHash, h, roundPos);
 
-    if(flames.inflames[roundPos.y][roundPos.x])
+    // the rays of its exploding bombs follow
+    if(h.flamelength != flamelength)
+      flames.activeBombsChanged();
+
+    if(flames.inflames(roundPos.y, roundPos.x))
     {
-      printf("Killed!\n");
+      if(match.verbose)
+        printf("Killed!\n");
+
       h.dead = true;
       continue;
     }
 
-    moveHero(h, input);
+    moveHero<V>(state, board, bombs, h, input);
 
-    if(input.dropBomb && !prevInput.dropBomb && activeBombCount(idx) < h.maxbombs)
+    if(input.dropBomb && !prevInput.dropBomb && bombs.ownerCount[idx] < h.maxbombs)
     {
       auto pos = round(h.pos);
 
-      if(!findBombAt(state, pos))
+      if(!findBombAt(state, bombs, pos))
       {
-        if(auto bomb = allocBomb(state))
+        const int bombIdx = state.bombs.alloc();
+
+        if(bombIdx >= 0)
         {
-          bomb->enable = true;
-          bomb->pos = { (float)pos.x, (float)pos.y };
-          bomb->countdown = 75;
-          bomb->ownerIndex = idx;
+          auto& bomb = state.bombs[bombIdx];
+          bomb.pos = { (float)pos.x, (float)pos.y };
+          bomb.countdown = 75;
+          bomb.ownerIndex = idx;
 
           if(h.upgrades & UPGRADE_JELLY)
-            bomb->jelly = 1;
+            bomb.jelly = 1;
+
+          bombs.add(bombIdx, pos);
+          bombs.ownerCount[idx]++;
         }
       }
     }
   }
 }
 
-void updateBombs(GameLogicState& state, const FlameCoverage& flames)
+// Makes the bombs caught in the flames of the bombs from 'worklist' start
+// exploding right away, and so on, instead of one link per tick.
+template<typename State>
+void resolveChainReactions(State& state, const BoardMasks<State>& board, const BombIndex<State>& bombs, FlameMap<State>& flames, int16_t* worklist, int count)
 {
-  for(auto& b : state.bombs)
+  while(count > 0)
   {
-    if(!b.enable)
-      continue;
+    auto& b = state.bombs[worklist[--count]];
+    const Vec2i pos0 = round(b.pos);
+    const int flamelength = state.heroes[b.ownerIndex].flamelength;
 
+    for(auto dir : flameDirs)
     {
-      b.enable = false;
+      const int n = ::scan(board, pos0, dir, flamelength);
 
-      if(!directMove(state, b.pos, Vec2f(0.9, 0.9), b.vel))
+      for(int i = 0; i < n; ++i)
+      {
+        const auto pos = pos0 + dir * i;
+
+        if(!((bombs.occupiedRows[pos.y] >> pos.x) & 1))
+          continue;
+
+        for(int j = bombs.head[pos.y][pos.x]; j != BombIndex<State>::None; j = bombs.next[j])
+        {
+          auto& other = state.bombs[j];
+
+          if(other.countdown <= 10)
+            continue;
+
+          // goes off together with the bomb that triggered it
+          other.countdown = b.countdown;
+          other.vel = { 0, 0 };
+          other.pos.x = ::round(other.pos.x);
+          other.pos.y = ::round(other.pos.y);
+          flames.bombChanged(j);
+          worklist[count++] = j;
+        }
+      }
+    }
+  }
+}
+
+template<typename V, typename State>
+void updateBombs(State& state, BoardMasks<State>& board, uint64_t& boardHash, BombIndex<State>& bombs, FlameMap<State>& flames, bool instantChains)
+{
+  using S = typename V::Scalar;
+
+  // bombs that start exploding during this tick
+  int16_t worklist[State::MAX_BOMBS];
+  int worklistSize = 0;
+
+  for(int idx = state.bombs.next(-1); idx >= 0; idx = state.bombs.next(idx))
+  {
+    auto& b = state.bombs[idx];
+    const bool wasArmed = b.countdown > 10;
+
+    {
+      const auto prevCell = round(b.pos);
+      auto pos = load<V>(b.pos);
+
+      if(directMove(state, board, bombs, pos, V(S(0.9), S(0.9)), load<V>(b.vel), idx))
+      {
+        b.pos = store(pos);
+      }
+      else
       {
         if(b.jelly)
         {
-          b.vel = b.vel * -1.0;
+          b.vel = store(load<V>(b.vel) * S(-1));
         }
         else
         {
@@ -353,11 +600,18 @@ void updateBombs(GameLogicState& state, const FlameCoverage& flames)
         }
       }
 
-      b.enable = true;
+      const auto cell = round(b.pos);
+
+      if(!(cell == prevCell))
+      {
+        bombs.remove(idx, prevCell);
+        bombs.add(idx, cell);
+        flames.bombChanged(idx);
+      }
     }
 
-    // flame-triggered explosion
-    if(b.countdown > 10 && flames.inflames[(int)b.pos.y][(int)b.pos.x])
+    // flame-triggered explosion, on the cell the bomb is indexed in
+    if(b.countdown > 10 && flames.inflames(round(b.pos).y, round(b.pos).x))
     {
       b.countdown = 10;
     }
@@ -368,18 +622,25 @@ void updateBombs(GameLogicState& state, const FlameCoverage& flames)
 
       if(b.countdown == 0)
       {
-        b.enable = false;
+        state.bombs.free(idx);
+        bombs.remove(idx, round(b.pos));
+        bombs.ownerCount[b.ownerIndex]--;
+        flames.bombChanged(idx);
 
         auto scan = [&] (Vec2i pos, Vec2i dir, int maxSteps)
           {
-            int n = ::scan(state, pos, dir, maxSteps);
+            int n = ::scan(board, pos, dir, maxSteps);
             auto finalPos = pos + dir * n;
 
-            if(n <= maxSteps && isDestroyable(state, finalPos))
-              state.board[finalPos.y][finalPos.x] = 0;
+            if(n <= maxSteps && isDestroyable(board, finalPos.y, finalPos.x))
+            {
+              destroyBrick(state, board, boardHash, finalPos.y, finalPos.x);
+              flames.clearedCells[flames.clearedCount++] = finalPos.y * State::COLS + finalPos.x;
+              flames.boardGeneration++; // reported above, no full rescan needed
+            }
           };
 
-        const Vec2i pos0 = { (int)b.pos.x, (int)b.pos.y };
+        const Vec2i pos0 = round(b.pos);
         const int flamelength = state.heroes[b.ownerIndex].flamelength;
         scan(pos0, { 1, 0 }, flamelength);
         scan(pos0, { -1, 0 }, flamelength);
@@ -392,47 +653,173 @@ void updateBombs(GameLogicState& state, const FlameCoverage& flames)
         b.vel = { 0, 0 };
         b.pos.x = ::round(b.pos.x);
         b.pos.y = ::round(b.pos.y);
+
+        if(wasArmed)
+        {
+          flames.bombChanged(idx);
+
+          if(instantChains)
+            worklist[worklistSize++] = idx;
+        }
       }
     }
   }
+
+  if(instantChains)
+    resolveChainReactions(state, board, bombs, flames, worklist, worklistSize);
+}
+
+template<typename State>
+void addFlameRays(FlameMap<State>& flames, const typename FlameMap<State>::Footprint& f, int delta)
+{
+  using Line = typename FlameMap<State>::Line;
+
+  for(int d = 0; d < 4; ++d)
+  {
+    for(int i = 0; i < f.len[d]; ++i)
+    {
+      const auto pos = Vec2i{ f.x, f.y } + flameDirs[d] * i;
+      auto& refs = flames.refs[pos.y][pos.x];
+      refs += delta;
+
+      if(refs)
+        flames.rows[pos.y] |= Line(1) << pos.x;
+      else
+        flames.rows[pos.y] &= ~(Line(1) << pos.x);
+    }
+  }
 }
 
-FlameCoverage computeFlameCoverage(const GameLogicState& state)
+// Updates the rays of the bomb slot 'i'.
+template<typename State>
+void syncBombRays(FlameMap<State>& flames, const State& state, const BoardMasks<State>& board, int i)
 {
-  FlameCoverage r;
+  auto& b = state.bombs[i];
+  auto& curr = flames.bombs[i];
+
+  typename FlameMap<State>::Footprint wanted {};
 
-  // compute board cells covered with flames
-  for(auto& b : state.bombs)
+  if(state.bombs.isLive(i) && b.countdown <= 10) // bomb is currently exploding
   {
-    if(!b.enable)
-      continue;
+    const Vec2i pos0 = round(b.pos);
+    wanted.active = true;
+    wanted.x = pos0.x;
+    wanted.y = pos0.y;
+    wanted.flamelength = state.heroes[b.ownerIndex].flamelength;
+  }
+
+  if(!wanted.active && !curr.active)
+    return;
 
-    if(b.countdown <= 10) // bomb is currently exploding
+  if(wanted.active)
+  {
+    for(int d = 0; d < 4; ++d)
+      wanted.len[d] = ::scan(board, { wanted.x, wanted.y }, flameDirs[d], wanted.flamelength);
+  }
+
+  if(memcmp(&wanted, &curr, sizeof wanted) == 0)
+    return;
+
+  addFlameRays(flames, curr, -1);
+  addFlameRays(flames, wanted, +1);
+  curr = wanted;
+
+  if(curr.active)
+    flames.active[i / 64] |= 1ull << (i % 64);
+  else
+    flames.active[i / 64] &= ~(1ull << (i % 64));
+}
+
+// Brings the flame map up to date with the events reported since the last call.
+// Only the bombs whose rays might have changed are rescanned.
+template<typename State>
+void syncFlameMap(FlameMap<State>& flames, const State& state, const BoardMasks<State>& board)
+{
+  if(flames.boardGeneration != board.generation)
+  {
+    // the board was rebuilt: any ray can have changed
+    flames.activeBombsChanged();
+    flames.boardGeneration = board.generation;
+  }
+  else
+  {
+    for(int k = 0; k < flames.clearedCount; ++k)
     {
-      auto scan = [&] (Vec2i pos, Vec2i dir, int maxSteps)
+      const int row = flames.clearedCells[k] / State::COLS;
+      const int col = flames.clearedCells[k] % State::COLS;
+
+      // the rays reaching the cell might now go further
+      for(int w = 0; w < State::BombPool::Words; ++w)
+      {
+        for(uint64_t mask = flames.active[w]; mask; mask &= mask - 1)
         {
-          int n = ::scan(state, pos, dir, maxSteps);
+          const int i = w * 64 + __builtin_ctzll(mask);
+          const auto& f = flames.bombs[i];
 
-          for(int i = 0; i < n; ++i)
-          {
-            auto pos2 = pos + dir * i;
-            r.inflames[pos2.y][pos2.x] = true;
-          }
-        };
-
-      const Vec2i pos0 = round(b.pos);
-      const int flamelength = state.heroes[b.ownerIndex].flamelength;
-      scan(pos0, { 1, 0 }, flamelength);
-      scan(pos0, { -1, 0 }, flamelength);
-      scan(pos0, { 0, 1 }, flamelength);
-      scan(pos0, { 0, -1 }, flamelength);
+          if((f.y == row && abs(f.x - col) <= f.flamelength) || (f.x == col && abs(f.y - row) <= f.flamelength))
+            flames.bombChanged(i);
+        }
+      }
     }
   }
 
-  return r;
+  flames.clearedCount = 0;
+
+  for(int w = 0; w < State::BombPool::Words; ++w)
+  {
+    for(uint64_t mask = flames.changed[w]; mask; mask &= mask - 1)
+    {
+      const int i = w * 64 + __builtin_ctzll(mask);
+      syncBombRays(flames, state, board, i);
+    }
+
+    flames.changed[w] = 0;
+  }
+}
+
+// Where hero 'i' starts: the four corners first, then evenly spread
+// along the border of the board.
+template<typename State>
+Vec2i startingPosition(int i)
+{
+  const int cols = State::COLS;
+  const int rows = State::ROWS;
+
+  const Vec2i corners[4] =
+  {
+    { 0, 0 },
+    { cols - 1, 0 },
+    { cols - 1, rows - 1 },
+    { 0, rows - 1 },
+  };
+
+  if(i < 4)
+    return corners[i];
+
+  // distance from the top-left corner, walking clockwise
+  const int perimeter = 2 * (cols - 1) + 2 * (rows - 1);
+  const int others = State::MAX_HEROES - 4;
+  int d = (2 * (i - 4) + 1) * perimeter / (2 * others);
+
+  if(d < cols - 1)
+    return { d, 0 };
+
+  d -= cols - 1;
+
+  if(d < rows - 1)
+    return { cols - 1, d };
+
+  d -= rows - 1;
+
+  if(d < cols - 1)
+    return { cols - 1 - d, rows - 1 };
+
+  d -= cols - 1;
+  return { 0, rows - 1 - d };
 }
 
-void putRandomItems(GameLogicState& state)
+template<typename State>
+void putRandomItems(Rng& rng, State& state)
 {
   static const int itemCounts[][2] =
   {
@@ -458,11 +845,16 @@ void putRandomItems(GameLogicState& state)
 
     if(count < 0)
     {
-      if(rand() % abs(count) == 0)
+      if(rng(abs(count)) == 0)
         count = 1;
       else
         count = 0;
     }
+    else
+    {
+      // the counts are tuned for the classic map
+      count = count * State::COLS * State::ROWS / (GameLogicState::COLS * GameLogicState::ROWS);
+    }
 
     for(int k = 0; k < count; ++k)
     {
@@ -471,8 +863,8 @@ void putRandomItems(GameLogicState& state)
 
       do
       {
-        freePos.x = rand() % state.COLS;
-        freePos.y = rand() % state.ROWS;
+        freePos.x = rng(state.COLS);
+        freePos.y = rng(state.ROWS);
 
         if(++watchdog > 1000)
           break;
@@ -485,9 +877,22 @@ void putRandomItems(GameLogicState& state)
 }
 }
 
-GameLogicState initGame()
+template<typename State>
+void rebuildMatchCaches(BasicGameMatch<State>& match, const State& state)
+{
+  match.boardMasks = {};
+  match.bombIndex = buildBombIndex(state);
+  match.flames = {};
+
+  // the exploding bombs get their rays at the next tick
+  for(int i = state.bombs.next(-1); i >= 0; i = state.bombs.next(i))
+    match.flames.bombChanged(i);
+}
+
+template<typename State>
+State initGame(BasicGameMatch<State>& match)
 {
-  GameLogicState state {};
+  State state {};
 
   // Fill map with bricks
   for(int row = 0; row < state.ROWS; ++row)
@@ -528,47 +933,87 @@ GameLogicState initGame()
       maybeClear(pos + Vec2i{ 0, +2 });
     };
 
-  static const Vec2i startingPositions[MAX_HEROES] =
+  for(int i = 0; i < spawnCount<State>(); ++i)
   {
-    { 0, 0 },
-    { state.COLS - 1, 0 },
-    { state.COLS - 1, state.ROWS - 1 },
-    { 0, state.ROWS - 1 },
-  };
-
-  for(int i = 0; i < 4; ++i)
-  {
-    state.heroes[i].enable = true;
+    const auto pos = startingPosition<State>(i);
+    state.heroes[i].enable = i < 4;
     state.heroes[i].maxbombs = 1;
-    state.heroes[i].pos = Vec2f(startingPositions[i].x, startingPositions[i].y);
+    state.heroes[i].pos = Vec2f(pos.x, pos.y);
     state.heroes[i].walkspeed = 2;
     state.heroes[i].flamelength = 2;
 
-    clearCross(startingPositions[i]);
+    clearCross(pos);
   }
 
-  putRandomItems(state);
+  putRandomItems(match.rng, state);
+  match.boardHash = hashBoard(state);
+  rebuildMatchCaches(match, state);
 
   return state;
 }
 
-GameLogicState advanceGameLogic(GameLogicState state, PlayerInputState inputs[MAX_HEROES])
+template<typename State>
+State advanceGameLogic(BasicGameMatch<State>& match, State state, PlayerInputState inputs[State::MAX_HEROES])
 {
-  if(intergameTimer > 0)
+  if(match.intergameTimer > 0)
   {
-    intergameTimer--;
+    match.intergameTimer--;
 
-    if(intergameTimer > 0)
+    if(match.intergameTimer > 0)
       return state;
 
-    printf("New game\n");
-    state = initGame();
+    if(match.verbose)
+      printf("New game\n");
+
+    // the heroes in play stay in play
+    bool enabled[State::MAX_HEROES];
+
+    for(int i = 0; i < State::MAX_HEROES; ++i)
+      enabled[i] = state.heroes[i].enable;
+
+    state = initGame(match);
+
+    for(int i = 0; i < State::MAX_HEROES; ++i)
+      state.heroes[i].enable |= enabled[i];
   }
 
-  auto const flames = computeFlameCoverage(state);
+  auto& profile = match.profile;
+  int64_t t0 = profile.enabled ? getMonotonicTimeNs() : 0;
+
+  // accumulates the time spent since the previous call
+  auto measure = [&] (int64_t& total)
+    {
+      if(!profile.enabled)
+        return;
+
+      const int64_t t1 = getMonotonicTimeNs();
+      total += t1 - t0;
+      t0 = t1;
+    };
+
+  auto& board = syncBoardMasks(match.boardMasks, state);
+  syncFlameMap(match.flames, state, board);
+  auto& flames = match.flames;
+  measure(profile.flamesNs);
+
+  auto& bombs = match.bombIndex;
+
+  if(match.checkCaches && !sameBombIndex(bombs, buildBombIndex(state), state))
+    throw std::runtime_error("Bomb index out of sync");
+
+  if(match.fixedPoint)
+    updateHeroes<Vec2x>(match, state, board, bombs, flames, inputs);
+  else
+    updateHeroes<Vec2f>(match, state, board, bombs, flames, inputs);
+
+  measure(profile.heroesNs);
+
+  if(match.fixedPoint)
+    updateBombs<Vec2x>(state, board, match.boardHash, bombs, flames, match.instantChains);
+  else
+    updateBombs<Vec2f>(state, board, match.boardHash, bombs, flames, match.instantChains);
 
-  updateHeroes(state, flames, inputs);
-  updateBombs(state, flames);
+  measure(profile.bombsNs);
 
   {
     int survivorCount = 0;
@@ -581,12 +1026,43 @@ GameLogicState advanceGameLogic(GameLogicState state, PlayerInputState inputs[MA
 
     if(survivorCount <= 1)
     {
-      printf("Game over!\n");
-      intergameTimer = 30;
+      if(match.verbose)
+        printf("Game over!\n");
+
+      match.intergameTimer = 30;
     }
   }
 
-  memcpy(lastInputs, inputs, sizeof lastInputs);
+  memcpy(match.lastInputs, inputs, sizeof match.lastInputs);
   return state;
 }
 
+template<typename State>
+void predictHeroMove(BoardMasks<State>& boardMasks, State& state, int heroIndex, PlayerInputState input, bool fixedPoint)
+{
+  auto& h = state.heroes[heroIndex];
+
+  if(!h.enable || h.dead)
+    return;
+
+  const auto& board = syncBoardMasks(boardMasks, state);
+  const auto bombs = buildBombIndex(state);
+
+  if(fixedPoint)
+    moveHero<Vec2x>(state, board, bombs, h, input);
+  else
+    moveHero<Vec2f>(state, board, bombs, h, input);
+}
+
+template void rebuildMatchCaches(GameMatch&, const GameLogicState&);
+template void rebuildMatchCaches(BasicGameMatch<GameLogicState31x21>&, const GameLogicState31x21&);
+template void rebuildMatchCaches(BasicGameMatch<GameLogicState63x63>&, const GameLogicState63x63&);
+template GameLogicState initGame(GameMatch&);
+template GameLogicState advanceGameLogic(GameMatch&, GameLogicState, PlayerInputState[]);
+template GameLogicState31x21 initGame(BasicGameMatch<GameLogicState31x21>&);
+template GameLogicState31x21 advanceGameLogic(BasicGameMatch<GameLogicState31x21>&, GameLogicState31x21, PlayerInputState[]);
+template GameLogicState63x63 initGame(BasicGameMatch<GameLogicState63x63>&);
+template GameLogicState63x63 advanceGameLogic(BasicGameMatch<GameLogicState63x63>&, GameLogicState63x63, PlayerInputState[]);
+template void predictHeroMove(BoardMasks<GameLogicState>&, GameLogicState&, int, PlayerInputState, bool);
+template void predictHeroMove(BoardMasks<GameLogicState31x21>&, GameLogicState31x21&, int, PlayerInputState, bool);
+template void predictHeroMove(BoardMasks<GameLogicState63x63>&, GameLogicState63x63&, int, PlayerInputState, bool);
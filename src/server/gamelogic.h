@@ -0,0 +1,232 @@
+// Game simulation entry points.
+// All the mutable state of a match is passed explicitly, so several matches
+// can be simulated at once, from different threads.
+#pragma once
+
+#include <cstdint>
+#include <cstring> // memset
+#include <type_traits> // conditional_t
+
+#include "game.h"
+#include "state_hash.h"
+
+// Deterministic PRNG (xorshift64*), one per match.
+struct Rng
+{
+  uint64_t state = 0x9E3779B97F4A7C15ull;
+
+  void seed(uint64_t value)
+  {
+    // never let the state be zero
+    state = value ^ 0x9E3779B97F4A7C15ull;
+
+    if(!state)
+      state = 1;
+  }
+
+  uint32_t next()
+  {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return uint32_t((state * 0x2545F4914F6CDD1Dull) >> 32);
+  }
+
+  // uniform-ish integer in [0, n)
+  int operator () (int n) { return int(next() % uint32_t(n)); }
+};
+
+// Time spent in each phase of advanceGameLogic, accumulated over the ticks.
+// Only measured when 'enabled' is set.
+struct GameLogicProfile
+{
+  bool enabled = false;
+  int64_t flamesNs = 0;
+  int64_t heroesNs = 0;
+  int64_t bombsNs = 0;
+};
+
+// Smallest unsigned type with at least 'Bits' bits.
+template<int Bits>
+using LineMaskFor = std::conditional_t<Bits <= 16, uint16_t, std::conditional_t<Bits <= 32, uint32_t, uint64_t>>;
+
+// Bitmask views of the board: one bit per cell.
+// A row holds bit 'col', a column holds bit 'row'.
+// Bits outside of the board are always clear.
+// Derived from State::board, and only rebuilt when the board changes.
+template<typename State>
+struct BoardMasks
+{
+  using Line = LineMaskFor<(State::COLS > State::ROWS ? State::COLS : State::ROWS)>;
+
+  static_assert(State::COLS <= 64 && State::ROWS <= 64);
+
+  bool valid = false;
+  uint32_t generation = 0; // incremented on each change
+  uint8_t board[State::ROWS][State::COLS] {}; // the board these masks describe
+  Line traversableRows[State::ROWS] {};
+  Line traversableCols[State::COLS] {};
+  Line destroyableRows[State::ROWS] {};
+  Line destroyableCols[State::COLS] {};
+};
+
+// Cells covered with flames, as a reference count per cell.
+// Each exploding bomb adds its four rays to the counts. The simulation
+// reports the events that can change them (a bomb starting or stopping to
+// explode, moving, a brick destroyed...), and only the rays these events
+// touch are rescanned.
+template<typename State>
+struct FlameMap
+{
+  // The rays of one bomb slot
+  struct Footprint
+  {
+    bool active;
+    int8_t x, y;
+    uint8_t flamelength;
+    uint8_t len[4]; // right, left, down, up: number of cells, including the bomb cell
+  };
+
+  using Line = typename BoardMasks<State>::Line;
+
+  // Each bomb destroys at most one brick per direction, once.
+  static constexpr int MaxClearedCells = 4 * State::MAX_BOMBS;
+
+  uint32_t boardGeneration = 0; // of the BoardMasks the rays were scanned on, plus the reported changes
+  Footprint bombs[State::MAX_BOMBS] {};
+  uint64_t active[State::BombPool::Words] {}; // slots with an active footprint
+  uint16_t refs[State::ROWS][State::COLS] {};
+  Line rows[State::ROWS] {}; // bit 'col' is set when refs[row][col] > 0
+
+  // Pending events, consumed by the next update
+  uint64_t changed[State::BombPool::Words] {}; // slots whose rays might have changed
+  uint16_t clearedCells[MaxClearedCells] {}; // destroyed bricks, as row * COLS + col
+  int clearedCount = 0;
+
+  bool inflames(int row, int col) const { return (rows[row] >> col) & 1; }
+
+  void bombChanged(int i) { changed[i / 64] |= 1ull << (i % 64); }
+
+  void activeBombsChanged()
+  {
+    for(int w = 0; w < State::BombPool::Words; ++w)
+      changed[w] |= active[w];
+  }
+};
+
+// Live bombs, indexed by cell (rounded position) and counted by owner.
+// Kept up to date as bombs are placed, move, or go away.
+template<typename State>
+struct BombIndex
+{
+  using Line = typename BoardMasks<State>::Line;
+
+  static constexpr int16_t None = -1;
+
+  int16_t head[State::ROWS][State::COLS]; // first bomb of each cell
+  int16_t next[State::MAX_BOMBS] {}; // next bomb in the same cell, by increasing bomb index
+  Line occupiedRows[State::ROWS] {}; // bit 'col' is set when the cell holds a bomb
+  int ownerCount[State::MAX_HEROES] {};
+
+  BombIndex()
+  {
+    memset(head, 0xff, sizeof head); // None
+  }
+
+  static bool isInside(Vec2i cell)
+  {
+    return unsigned(cell.y) < unsigned(State::ROWS) && unsigned(cell.x) < unsigned(State::COLS);
+  }
+
+  void add(int bombIdx, Vec2i cell)
+  {
+    if(!isInside(cell))
+      return;
+
+    auto* link = &head[cell.y][cell.x];
+
+    while(*link != None && *link < bombIdx)
+      link = &next[*link];
+
+    next[bombIdx] = *link;
+    *link = bombIdx;
+    occupiedRows[cell.y] |= Line(1) << cell.x;
+  }
+
+  void remove(int bombIdx, Vec2i cell)
+  {
+    if(!isInside(cell))
+      return;
+
+    auto* link = &head[cell.y][cell.x];
+
+    while(*link != None && *link != bombIdx)
+      link = &next[*link];
+
+    if(*link == bombIdx)
+      *link = next[bombIdx];
+
+    if(head[cell.y][cell.x] == None)
+      occupiedRows[cell.y] &= ~(Line(1) << cell.x);
+  }
+};
+
+// Server-only state of one match: everything the simulation needs besides
+// the state itself.
+template<typename State>
+struct BasicGameMatch
+{
+  PlayerInputState lastInputs[State::MAX_HEROES] {};
+  int intergameTimer = 0;
+  uint64_t boardHash = 0; // hashBoard() of the state, kept up to date as the cells change
+  Rng rng;
+  BoardMasks<State> boardMasks;
+  FlameMap<State> flames;
+  BombIndex<State> bombIndex; // of the state last returned by initGame or advanceGameLogic
+
+  bool instantChains = false; // bombs caught in an explosion go off in the same tick
+  bool fixedPoint = false; // bit-exact movement math, whatever the compiler and the platform
+
+  bool verbose = true; // log game events to stdout
+  bool checkCaches = false; // debug: compare the bomb index against a full rebuild each tick, throw on mismatch
+  GameLogicProfile profile;
+};
+
+using GameMatch = BasicGameMatch<GameLogicState>;
+
+// Number of hero slots that get a starting position, and can play.
+// The classic map only has room for the four corners.
+template<typename State>
+constexpr int spawnCount()
+{
+  return State::PRESET == MapPreset::Classic ? 4 : State::MAX_HEROES;
+}
+
+// Instantiated for each MapPreset.
+template<typename State>
+State initGame(BasicGameMatch<State>& match);
+
+// Rebuilds the caches of 'match' (board masks, flames, bomb index) for 'state',
+// e.g when both were loaded from a demo file.
+template<typename State>
+void rebuildMatchCaches(BasicGameMatch<State>& match, const State& state);
+
+// 'state' must be the last one returned by initGame or advanceGameLogic,
+// or differ from it only by its heroes: 'match' indexes its bombs.
+template<typename State>
+State advanceGameLogic(BasicGameMatch<State>& match, State state, PlayerInputState inputs[State::MAX_HEROES]);
+
+// Client-side prediction: moves hero 'heroIndex' by one tick of 'input',
+// with the same movement code as advanceGameLogic. Nothing else is simulated.
+// 'boardMasks' is a cache, only rebuilt when the board changes.
+template<typename State>
+void predictHeroMove(BoardMasks<State>& boardMasks, State& state, int heroIndex, PlayerInputState input, bool fixedPoint);
+
+// Same as hashState(state), without rehashing the whole board.
+// 'state' must be the last one returned by initGame or advanceGameLogic,
+// or differ from it only by its heroes and bombs.
+template<typename State>
+uint64_t stateHash(const BasicGameMatch<State>& match, const State& state)
+{
+  return match.boardHash ^ hashEntities(state);
+}
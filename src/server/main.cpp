@@ -4,28 +4,208 @@
 // - client (player) bookeeping
 // Should depend only on file I/O and network (socket).
 // No SDL/OpenGL is allowed here: this program must be able to run headless.
-#include <chrono>
+#include <algorithm> // max
+#include <cstddef> // offsetof
 #include <cstdio>
-#include <thread>
-#include <type_traits>
+#include <cstdlib> // strtol
+#include <stdexcept>
+#include <string>
 
+#include "clock.h"
+#include "demo.h"
 #include "protocol.h"
+#include "scheduler.h"
 #include "server.h"
 #include "socket.h"
 #include "span.h"
 
+namespace
+{
+// When we fall behind by more than this, the late ticks are dropped
+// instead of being simulated in a burst.
+const int MaxCatchUpTicks = 5;
+
+struct CommandLine
+{
+  ServerConfig config;
+  std::string replayPath;
+  bool queryMetrics = false;
+};
+
+// Asks the server running on this host for its metrics, and prints them.
+void queryMetrics()
+{
+  Socket sock(0);
+  const auto server = Address::build("127.0.0.1", ServerUdpPort);
+
+  PacketQueryMetrics query {};
+  query.hdr.op = Op::QueryMetrics;
+  sock.send(server, { (const uint8_t*)&query, int(sizeof query) });
+
+  const int64_t deadline = getMonotonicTimeNs() + 1000000000ll;
+
+  // the parts of the reply, in order
+  std::string parts[MaxMetricsParts];
+  bool received[MaxMetricsParts] {};
+  int partCount = -1;
+  int receivedCount = 0;
+  bool truncated = false;
+
+  while(getMonotonicTimeNs() < deadline && receivedCount != partCount)
+  {
+    PacketMetrics reply;
+    Address from;
+    const int n = sock.recv(from, { (uint8_t*)&reply, int(sizeof reply) });
+    const int headerSize = offsetof(PacketMetrics, text);
+
+    if(n >= headerSize && reply.hdr.op == Op::Metrics && reply.partCount <= MaxMetricsParts && reply.part < reply.partCount)
+    {
+      partCount = reply.partCount;
+      truncated = reply.truncated;
+
+      if(!received[reply.part])
+      {
+        received[reply.part] = true;
+        parts[reply.part].assign(reply.text, n - headerSize);
+        receivedCount++;
+      }
+
+      continue;
+    }
+
+    sleepUntil(getMonotonicTimeNs() + 10000000);
+  }
+
+  if(partCount < 0)
+    throw std::runtime_error("No answer from the server");
+
+  if(partCount == 1 && parts[0].empty())
+    printf("# no metrics yet\n");
+
+  for(int i = 0; i < partCount; ++i)
+    fwrite(parts[i].data(), 1, parts[i].size(), stdout);
+
+  if(receivedCount < partCount)
+    printf("# incomplete reply: received %d of %d datagrams\n", receivedCount, partCount);
+
+  if(truncated)
+    printf("# truncated reply: the server dropped the last lines\n");
+}
+
+CommandLine parseCommandLine(Span<const String> args)
+{
+  CommandLine r;
+  auto& config = r.config;
+
+  auto stringArg = [&] (int& i)
+    {
+      if(i + 1 >= args.len)
+        throw std::runtime_error("Missing value for option");
+
+      ++i;
+      return std::string(args[i].data, args[i].len);
+    };
+
+  auto intArg = [&] (int& i)
+    {
+      const auto s = stringArg(i);
+      char* end;
+      const long value = strtol(s.c_str(), &end, 10);
+
+      if(s.empty() || *end)
+        throw std::runtime_error("Invalid number: '" + s + "'");
+
+      return (int)value;
+    };
+
+  for(int i = 1; i < args.len; ++i)
+  {
+    const std::string arg(args[i].data, args[i].len);
+
+    if(arg == "--raw-states")
+      config.rawStates = true;
+    else if(arg == "--instant-chains")
+      config.instantChains = true;
+    else if(arg == "--fixed-point")
+      config.fixedPoint = true;
+    else if(arg == "--bots")
+      config.bots = intArg(i);
+    else if(arg == "--bot-budget")
+      config.botBudgetUs = intArg(i);
+    else if(arg == "--record")
+      config.recordDir = stringArg(i);
+    else if(arg == "--replay")
+      r.replayPath = stringArg(i);
+    else if(arg == "--metrics")
+      config.metricsPath = stringArg(i);
+    else if(arg == "--metrics-period")
+      config.metricsPeriodMs = intArg(i);
+    else if(arg == "--query-metrics")
+      r.queryMetrics = true;
+    else
+      throw std::runtime_error("Unknown option: '" + arg + "'");
+  }
+
+  // each room has at most the slots of its preset
+  int maxBots = 0;
+
+  for(int i = 0; i < (int)MapPreset::Count; ++i)
+    visitPreset((MapPreset)i, [&] (auto tag) { maxBots = std::max(maxBots, spawnCount<typename decltype(tag)::type>()); });
+
+  if(config.bots < 0 || config.bots > maxBots)
+    throw std::runtime_error("Invalid bot count");
+
+  if(config.botBudgetUs < 1)
+    throw std::runtime_error("Invalid bot budget");
+
+  if(config.metricsPeriodMs < 1)
+    throw std::runtime_error("Invalid metrics period");
+
+  return r;
+}
+}
+
 void safeMain(Span<const String> args)
 {
-  (void)args;
+  const auto cmdLine = parseCommandLine(args);
+
+  if(cmdLine.queryMetrics)
+  {
+    queryMetrics();
+    return;
+  }
+
+  if(!cmdLine.replayPath.empty())
+  {
+    const auto result = replayDemo(cmdLine.replayPath.c_str());
+    printf("Replayed %d ticks, %d checkpoints, %d mismatches\n", result.ticks, result.checkpoints, result.mismatches);
+
+    if(result.mismatches)
+      throw std::runtime_error("Replay diverged from the recording");
+
+    return;
+  }
+
+  const auto& config = cmdLine.config;
+
   Socket sock(ServerUdpPort);
   printf("Server listening on: udp/%d\n", sock.port());
 
-  auto server = createServer(sock);
+  auto server = createServer(sock, config);
+
+  TickScheduler scheduler(GamePeriodMs * 1000000ll, MaxCatchUpTicks);
 
   for(;;)
   {
-    server->tick();
-    std::this_thread::sleep_for(std::chrono::milliseconds(GamePeriodMs));
+    const int dueTicks = scheduler.waitNextTicks();
+
+    // timed one by one, so a catch-up burst doesn't look like a slow tick
+    for(int i = 0; i < dueTicks; ++i)
+    {
+      const auto t0 = getMonotonicTimeNs();
+      server->tick();
+      scheduler.reportTickDuration(getMonotonicTimeNs() - t0);
+    }
   }
 }
 
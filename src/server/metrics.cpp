@@ -0,0 +1,135 @@
+#include "metrics.h"
+
+#include <cstdio>
+#include <utility> // move
+
+#include "stats.h"
+
+namespace
+{
+const char* const dropReasonNames[] =
+{
+  "malformed",
+  "unknown_room",
+  "unknown_player",
+  "room_full",
+  "send_failed",
+};
+
+static_assert(sizeof(dropReasonNames) / sizeof(*dropReasonNames) == (int)DropReason::Count);
+
+struct TextWriter
+{
+  std::string& out;
+
+  void type(const char* name, const char* type)
+  {
+    append("# TYPE blaast_%s %s\n", name, type);
+  }
+
+  template<typename... Args>
+  void append(const char* fmt, Args... args)
+  {
+    char buf[256];
+    const int n = snprintf(buf, sizeof buf, fmt, args...);
+    out.append(buf, n < (int)sizeof buf ? n : sizeof buf - 1);
+  }
+};
+}
+
+MetricsExporter::MetricsExporter(std::string path, int64_t periodNs)
+  : m_path(std::move(path)), m_period(periodNs)
+{
+}
+
+void MetricsExporter::update(ServerMetrics& m, int64_t now)
+{
+  if(m_lastDate < 0)
+  {
+    m_lastDate = now;
+    m_last = m;
+  }
+
+  if(now - m_lastDate < m_period)
+    return;
+
+  const double elapsed = (now - m_lastDate) / 1e9;
+  const int64_t ticks = m.ticks - m_last.ticks;
+
+  auto rate = [&] (int64_t curr, int64_t prev) { return (curr - prev) / elapsed; };
+
+  m_text.clear();
+  TextWriter w { m_text };
+
+  w.type("ticks_total", "counter");
+  w.append("blaast_ticks_total %lld\n", (long long)m.ticks);
+  w.type("tick_duration_seconds", "gauge");
+  w.append("blaast_tick_duration_seconds{stat=\"mean\"} %.6f\n", ticks ? m.tickNsSum / 1e9 / ticks : 0.0);
+  w.append("blaast_tick_duration_seconds{stat=\"max\"} %.6f\n", m.tickNsMax / 1e9);
+
+  w.type("rooms", "gauge");
+  w.append("blaast_rooms %d\n", m.rooms);
+  w.type("players", "gauge");
+  w.append("blaast_players %d\n", m.players);
+
+  w.type("packets_total", "counter");
+  w.append("blaast_packets_total{dir=\"in\"} %lld\n", (long long)m.packetsIn);
+  w.append("blaast_packets_total{dir=\"out\"} %lld\n", (long long)m.packetsOut);
+  w.type("bytes_total", "counter");
+  w.append("blaast_bytes_total{dir=\"in\"} %lld\n", (long long)m.bytesIn);
+  w.append("blaast_bytes_total{dir=\"out\"} %lld\n", (long long)m.bytesOut);
+
+  w.type("packets_per_second", "gauge");
+  w.append("blaast_packets_per_second{dir=\"in\"} %.1f\n", rate(m.packetsIn, m_last.packetsIn));
+  w.append("blaast_packets_per_second{dir=\"out\"} %.1f\n", rate(m.packetsOut, m_last.packetsOut));
+  w.type("bytes_per_second", "gauge");
+  w.append("blaast_bytes_per_second{dir=\"in\"} %.1f\n", rate(m.bytesIn, m_last.bytesIn));
+  w.append("blaast_bytes_per_second{dir=\"out\"} %.1f\n", rate(m.bytesOut, m_last.bytesOut));
+
+  w.type("dropped_packets_total", "counter");
+
+  for(int i = 0; i < (int)DropReason::Count; ++i)
+    w.append("blaast_dropped_packets_total{reason=\"%s\"} %lld\n", dropReasonNames[i], (long long)m.drops[i]);
+
+  // the values recorded with Stat(), e.g by the tick scheduler
+  w.type("stat", "gauge");
+
+  for(int i = 0; i < getStatCount(); ++i)
+  {
+    const auto stat = getStat(i);
+    w.append("blaast_stat{name=\"%.*s\"} %g\n", stat.name.len, stat.name.data, stat.val);
+  }
+
+  m.tickNsSum = 0;
+  m.tickNsMax = 0;
+  m_last = m;
+  m_lastDate = now;
+
+  if(!m_path.empty())
+    write();
+}
+
+// Writes to a temporary file first, so readers never see a partial file.
+void MetricsExporter::write() const
+{
+  const auto tmpPath = m_path + ".tmp";
+  FILE* fp = fopen(tmpPath.c_str(), "w");
+
+  if(!fp)
+  {
+    printf("Can't write metrics to '%s'\n", tmpPath.c_str());
+    return;
+  }
+
+  fwrite(m_text.data(), 1, m_text.size(), fp);
+  fclose(fp);
+
+  // rename doesn't replace an existing file on every platform
+  if(rename(tmpPath.c_str(), m_path.c_str()) != 0)
+  {
+    remove(m_path.c_str());
+
+    if(rename(tmpPath.c_str(), m_path.c_str()) != 0)
+      printf("Can't write metrics to '%s'\n", m_path.c_str());
+  }
+}
@@ -0,0 +1,62 @@
+// Server health telemetry.
+// The server accumulates counters as it runs. Once per period, they are
+// turned into rates, and formatted in the Prometheus text format, along with
+// the values of Stat(). The text is written to a file (e.g for the textfile
+// collector of a node exporter), and kept to answer Op::QueryMetrics.
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+enum class DropReason
+{
+  Malformed, // truncated, or invalid room, preset or op
+  UnknownRoom, // not a KeepAlive, for a room that isn't open
+  UnknownPlayer, // not a KeepAlive, from an address that isn't in the room
+  RoomFull,
+  SendFailed, // outgoing datagram, rejected by the socket
+  Count,
+};
+
+struct ServerMetrics
+{
+  // counters, since the start
+  int64_t ticks = 0;
+  int64_t packetsIn = 0;
+  int64_t bytesIn = 0;
+  int64_t packetsOut = 0;
+  int64_t bytesOut = 0;
+  int64_t drops[(int)DropReason::Count] {};
+
+  // since the last export
+  int64_t tickNsSum = 0;
+  int64_t tickNsMax = 0;
+
+  // current values
+  int rooms = 0;
+  int players = 0;
+
+  void drop(DropReason reason) { drops[(int)reason]++; }
+};
+
+struct MetricsExporter
+{
+  // 'path' can be empty: the text is then only available to text().
+  MetricsExporter(std::string path, int64_t periodNs);
+
+  // Formats and exports 'metrics' if the period has elapsed since the last
+  // export. Resets the per-period values.
+  void update(ServerMetrics& metrics, int64_t now);
+
+  // The last formatted metrics. Empty until the first period has elapsed.
+  const std::string& text() const { return m_text; }
+
+private:
+  void write() const;
+
+  const std::string m_path;
+  const int64_t m_period;
+  int64_t m_lastDate = -1;
+  ServerMetrics m_last; // counters at 'm_lastDate'
+  std::string m_text;
+};
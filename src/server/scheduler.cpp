@@ -0,0 +1,48 @@
+#include "scheduler.h"
+
+#include "clock.h"
+#include "stats.h"
+
+TickScheduler::TickScheduler(int64_t periodNs, int maxCatchUpTicks)
+  : m_period(periodNs), m_maxCatchUpTicks(maxCatchUpTicks)
+{
+  m_deadline = getMonotonicTimeNs() + m_period;
+}
+
+int TickScheduler::waitNextTicks()
+{
+  sleepUntil(m_deadline);
+
+  static const auto s_lateness = registerStat("Tick lateness (ms)");
+  static const auto s_overruns = registerStat("Tick overruns");
+  static const auto s_skipped = registerStat("Ticks skipped");
+
+  const int64_t lateness = getMonotonicTimeNs() - m_deadline;
+  Stat(s_lateness, lateness / 1000000.0);
+
+  // the deadline we just reached, plus all the ones we overslept
+  int dueTicks = 1 + int(lateness / m_period);
+
+  if(dueTicks > 1)
+    m_overrunCount++;
+
+  if(dueTicks > m_maxCatchUpTicks)
+  {
+    m_skippedCount += dueTicks - m_maxCatchUpTicks;
+    m_deadline += int64_t(dueTicks - m_maxCatchUpTicks) * m_period;
+    dueTicks = m_maxCatchUpTicks;
+  }
+
+  m_deadline += int64_t(dueTicks) * m_period;
+
+  Stat(s_overruns, m_overrunCount);
+  Stat(s_skipped, m_skippedCount);
+
+  return dueTicks;
+}
+
+void TickScheduler::reportTickDuration(int64_t durationNs)
+{
+  static const auto s_duration = registerStat("Tick duration (ms)");
+  Stat(s_duration, durationNs / 1000000.0);
+}
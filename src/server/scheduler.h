@@ -0,0 +1,27 @@
+// Fixed-timestep tick scheduler.
+// Ticks are due on a grid of absolute deadlines (start + k * period), so the
+// time spent ticking doesn't accumulate into drift.
+#pragma once
+
+#include <stdint.h>
+
+struct TickScheduler
+{
+  TickScheduler(int64_t periodNs, int maxCatchUpTicks);
+
+  // Blocks until the next tick is due, then returns how many ticks
+  // should be run back-to-back to catch up (at least one).
+  // When more than 'maxCatchUpTicks' ticks are late, the excess is skipped
+  // and the deadline grid is moved forward.
+  int waitNextTicks();
+
+  // Reports the duration of a single tick.
+  void reportTickDuration(int64_t durationNs);
+
+private:
+  const int64_t m_period;
+  const int m_maxCatchUpTicks;
+  int64_t m_deadline;
+  int64_t m_overrunCount = 0;
+  int64_t m_skippedCount = 0;
+};
@@ -1,12 +1,23 @@
+#include <algorithm> // min, max
+#include <chrono>
+#include <cstddef> // offsetof
 #include <cstdio>
 #include <cstring> // memcpy
-
+#include <ctime>
+#include <map>
+#include <random>
+
+#include "bots.h"
+#include "clock.h"
+#include "delta.h"
+#include "demo.h"
 #include "game.h"
+#include "gamelogic.h"
+#include "metrics.h"
 #include "protocol.h"
+#include "serialization.h"
 #include "server.h"
-
-extern GameLogicState advanceGameLogic(GameLogicState state, PlayerInputState inputs[MAX_HEROES]);
-extern GameLogicState initGame();
+#include "snapshots.h"
 
 namespace
 {
@@ -30,6 +41,19 @@ void unstableRemove(std::vector<T>& container, Lambda predicate)
   }
 }
 
+// Nonzero, and different from the previous runs of the server.
+uint32_t newRoomInstance()
+{
+  static std::random_device device;
+  uint32_t instance;
+
+  do
+    instance = device();
+  while(instance == 0);
+
+  return instance;
+}
+
 int getPlayerIndex(GameSession const& session, Address address)
 {
   for(auto& player : session.players)
@@ -40,12 +64,18 @@ int getPlayerIndex(GameSession const& session, Address address)
   return -1;
 }
 
-int allocHero(const GameSession& session)
+template<int MaxHeroes>
+void getHeroesInUse(const GameSession& session, bool (&heroInUse)[MaxHeroes])
 {
-  bool heroInUse[MAX_HEROES] {};
-
   for(auto& player : session.players)
     heroInUse[player.heroIndex] = true;
+}
+
+template<int MaxHeroes>
+int allocHero(const GameSession& session)
+{
+  bool heroInUse[MaxHeroes] {};
+  getHeroesInUse(session, heroInUse);
 
   for(auto& inUse : heroInUse)
   {
@@ -56,68 +86,241 @@ int allocHero(const GameSession& session)
   return -1;
 }
 
-struct Server : ITickable
+static constexpr int MAX_WATCHDOG = 200;
+
+// The inputs of one player, applied one per tick, in the order the client
+// sampled them. Inputs are repeated by the following packets, so only a
+// long burst of losses leaves a gap.
+struct InputQueue
 {
-  Server(Socket& sock_) : sock(sock_), state(initGame())
+  static constexpr int Capacity = 32;
+
+  // Beyond this, the queue only adds latency: the client runs ahead of
+  // the server, or a burst of late packets arrived at once.
+  static constexpr int MaxQueued = 3;
+
+  struct Entry
+  {
+    uint32_t seq;
+    PlayerInputState input;
+  };
+
+  Entry entries[Capacity] {};
+  uint32_t applied = 0; // last input applied
+  uint32_t newest = 0; // last input received
+
+  void receive(uint32_t seq, PlayerInputState input)
   {
-    printf("State packet size: %d\n", (int)sizeof(PacketState));
+    if(seq <= applied)
+      return; // already applied
+
+    // too far ahead to be queued: forget about the older ones
+    if(seq - applied > Capacity)
+      applied = seq - Capacity;
+
+    entries[seq % Capacity] = { seq, input };
+    newest = std::max(newest, seq);
   }
 
-  static constexpr int MAX_WATCHDOG = 200;
+  // Returns false if there's no new input.
+  bool pop(PlayerInputState& input)
+  {
+    if(newest <= applied)
+      return false;
 
-  void tick() override
+    // skip the oldest inputs, but keep their bomb presses
+    bool dropBomb = false;
+
+    while(newest - applied > MaxQueued)
+    {
+      auto& entry = entries[++applied % Capacity];
+
+      if(entry.seq == applied)
+        dropBomb |= entry.input.dropBomb;
+    }
+
+    // the next input we have: the ones in between were lost
+    do
+      ++applied;
+    while(entries[applied % Capacity].seq != applied);
+
+    input = entries[applied % Capacity].input;
+    input.dropBomb |= dropBomb;
+    return true;
+  }
+};
+
+// One match: its players, its simulation, its inputs.
+struct Room
+{
+  Room(int id_, ServerMetrics& metrics_) : id(id_), instance(newRoomInstance()), metrics(metrics_)
   {
-    static auto isDead = [] (const GameSession::Player& p) { return p.watchdog > MAX_WATCHDOG; };
+  }
+
+  virtual ~Room() = default;
+
+  virtual void tick() = 0;
+
+  // Queues the new state for all the players of this room.
+  // Each player gets a delta against the last snapshot it acknowledged,
+  // or a keyframe if we don't have this snapshot anymore.
+  // The queued datagrams point into this room, and stay valid until the next tick.
+  virtual void broadcastNewState(std::vector<OutgoingDatagram>& outgoing) = 0;
+
+  virtual void processPacket(Address from, Span<const uint8_t> buf) = 0;
+
+  virtual bool isEmpty() const = 0;
+  virtual int playerCount() const = 0;
+
+  const int id;
+  const uint32_t instance; // sent with each state packet, see PacketStateHeader
 
-    while(processOneIncomingPacket())
+protected:
+  ServerMetrics& metrics;
+};
+
+// The room of one MapPreset.
+template<typename State>
+struct RoomImpl : Room
+{
+  using Snapshot = SnapshotFor<State>;
+
+  RoomImpl(int id_, const ServerConfig& config, ServerMetrics& metrics_)
+    : Room(id_, metrics_)
+    , encoding(config.rawStates ? StateEncoding::Raw : StateEncoding::Compact)
+    , botCount(std::min(std::max(config.bots, 0), spawnCount<State>()))
+    , botBudgetNs(config.botBudgetUs * 1000ll)
+  {
+    match.rng.seed(std::chrono::steady_clock::now().time_since_epoch().count() * MaxRooms + id);
+    match.instantChains = config.instantChains;
+    match.fixedPoint = config.fixedPoint;
+    state = initGame(match);
+
+    if(!config.recordDir.empty())
     {
+      char path[1024];
+      snprintf(path, sizeof path, "%s/room%d-%lld.demo", config.recordDir.c_str(), id, (long long)time(nullptr));
+      printf("[room %d] Recording to '%s'\n", id, path);
+      recorder = std::make_unique<BasicDemoWriter<State>>(path);
     }
+  }
+
+  void tick() override
+  {
+    static auto isDead = [] (const GameSession::Player& p) { return p.watchdog > MAX_WATCHDOG; };
+
+    for(auto& player : session.players)
+      inputQueues[player.heroIndex].pop(inputs[player.heroIndex]);
+
+    updateBots();
+
+    if(recorder)
+      recorder->writeTick(match, state, inputs, stateModified);
 
-    state = advanceGameLogic(state, inputs);
+    stateModified = false;
+
+    state = advanceGameLogic(match, state, inputs);
+    ++tickCount;
 
     // remove unresponsive network clients
     unstableRemove(session.players, isDead);
-    broadcastNewState();
   }
 
-  void broadcastNewState()
+  void broadcastNewState(std::vector<OutgoingDatagram>& outgoing) override
   {
-    PacketState pkt;
-    pkt.hdr.op = Op::State;
-    pkt.state = state;
+    const uint64_t hash = stateHash(match, state);
+
+    // An unchanged state doesn't get a new snapshot:
+    // the last one is only resent to the players that didn't acknowledge it.
+    if(seq == 0 || hash != lastHash)
+    {
+      ++seq;
+      lastHash = hash;
+      lastTick = tickCount;
+
+      auto& snapshot = snapshots[seq % SnapshotHistory];
+      snapshot.seq = seq;
+      snapshot.size = serializeState(state, snapshot.data, encoding);
+    }
+
+    const auto& snapshot = snapshots[seq % SnapshotHistory];
+
+    encodedCount = 0;
+
+    // The fragments are encoded once per baseline, then copied for each
+    // player, to fill in the fields that are specific to the recipient.
+    // The players that are up to date get a heartbeat instead.
+    // Sized before taking any pointer into it.
+    int fragCount = 0;
+
+    for(auto& player : session.players)
+    {
+      playerPackets[&player - session.players.data()] = nullptr;
+
+      if(player.ackSeq != seq)
+      {
+        auto& encoded = encodeStatePacket(snapshot, findSnapshot(player.ackSeq));
+        playerPackets[&player - session.players.data()] = &encoded;
+        fragCount += encoded.fragCount;
+      }
+      else
+      {
+        fragCount++;
+      }
+    }
+
+    if((int)sent.size() < fragCount)
+      sent.resize(fragCount);
+
+    fragCount = 0;
 
     for(auto& player : session.players)
     {
-      static_assert(std::is_standard_layout<decltype(pkt)>::value);
-      sock.send(player.address, { (const uint8_t*)&pkt, int(sizeof pkt) });
+      if(auto encoded = playerPackets[&player - session.players.data()])
+      {
+        for(int i = 0; i < encoded->fragCount; ++i)
+        {
+          auto& pkt = sent[fragCount++];
+          memcpy(&pkt, &encoded->frags[i], encoded->sizes[i]);
+          pkt.heroIndex = player.heroIndex;
+          pkt.inputSeq = inputQueues[player.heroIndex].applied;
+          outgoing.push_back({ player.address, { (const uint8_t*)&pkt, encoded->sizes[i] } });
+        }
+      }
+      else
+      {
+        auto& pkt = sent[fragCount++];
+        pkt.hdr.op = Op::State;
+        pkt.hdr.roomId = id;
+        pkt.instance = instance;
+        pkt.seq = seq;
+        pkt.baseSeq = seq;
+        pkt.fragIndex = 0;
+        pkt.fragCount = 0;
+        pkt.fixedPoint = match.fixedPoint;
+        pkt.heroIndex = player.heroIndex;
+        pkt.inputSeq = inputQueues[player.heroIndex].applied;
+        pkt.tick = lastTick;
+        pkt.stateHash = lastHash;
+        outgoing.push_back({ player.address, { (const uint8_t*)&pkt, int(sizeof(PacketStateHeader)) } });
+      }
+
       player.watchdog++;
 
       if(player.watchdog > MAX_WATCHDOG / 2)
-        printf("Player #%d is not responding\n", int(&player - session.players.data()));
+        printf("[room %d] Player #%d is not responding\n", id, int(&player - session.players.data()));
     }
   }
 
-private:
-  Socket& sock;
-  GameSession session {};
-  GameLogicState state;
-  PlayerInputState inputs[MAX_HEROES] {};
-
-  bool processOneIncomingPacket()
+  void processPacket(Address from, Span<const uint8_t> buf) override
   {
-    uint8_t buf[2048];
-    Address from;
-    int n = sock.recv(from, buf);
-
-    if(n == 0)
-      return false;
-
+    auto hdr = (const PacketHeader*)buf.data;
     int idx = getPlayerIndex(session, from);
 
-    if(idx == -1 && buf[0] == Op::KeepAlive)
+    if(idx == -1 && hdr->op == Op::KeepAlive)
     {
       idx = session.players.size();
-      const int heroIdx = allocHero(session);
+      const int heroIdx = allocHero<State::MAX_HEROES>(session);
 
       if(heroIdx >= 0)
       {
@@ -125,53 +328,420 @@ private:
         auto& player = session.players.back();
         player.heroIndex = heroIdx;
         player.address = from;
+        player.joinSeq = seq;
+        inputs[heroIdx] = {};
+        inputQueues[heroIdx] = {};
         state.heroes[heroIdx].enable = true;
-        printf("New player (#%d): %s\n", heroIdx, from.toString().c_str());
+        stateModified = true;
+        printf("[room %d] New player (#%d): %s\n", id, heroIdx, from.toString().c_str());
       }
       else
       {
-        printf("Server is full\n");
-        idx = -1;
+        printf("[room %d] Room is full\n", id);
+        metrics.drop(DropReason::RoomFull);
+        return;
       }
     }
 
     if(idx == -1)
     {
-      printf("Skipping packet from unknown player: %s\n", from.toString().c_str());
-      return true;
+      printf("[room %d] Skipping packet from unknown player: %s\n", id, from.toString().c_str());
+      metrics.drop(DropReason::UnknownPlayer);
+      return;
     }
 
     session.players[idx].watchdog = 0;
-    switch(buf[0])
+    switch(hdr->op)
     {
     case Op::KeepAlive:
       break;
     case Op::Disconnect:
       session.players.erase(session.players.begin() + idx);
-      printf("Player #%d has left\n", idx);
+      printf("[room %d] Player #%d has left\n", id, idx);
       break;
     case Op::PlayerInput:
       {
-        auto pkt = (PacketPlayerInput*)buf;
-        const int heroIdx = session.players[idx].heroIndex;
-        memcpy(&inputs[heroIdx], &pkt->input, sizeof(PlayerInputState));
+        if(buf.len < (int)sizeof(PacketPlayerInput))
+        {
+          metrics.drop(DropReason::Malformed);
+          break;
+        }
+
+        auto pkt = (const PacketPlayerInput*)buf.data;
+        auto& player = session.players[idx];
+        auto& queue = inputQueues[player.heroIndex];
+        const int count = std::min<uint32_t>({ pkt->inputCount, MaxInputHistory, pkt->inputSeq });
+
+        for(int i = count - 1; i >= 0; --i)
+          queue.receive(pkt->inputSeq - i, unpackInput(pkt->inputs[i]));
+
+        // ignore acks older than the player itself: they come from a previous session
+        if(pkt->ackSeq > player.ackSeq && pkt->ackSeq > player.joinSeq && pkt->ackSeq <= seq)
+          player.ackSeq = pkt->ackSeq;
       }
       break;
     case Op::Restart:
-      state = initGame();
+      state = initGame(match);
+      stateModified = true;
       break;
     default:
-      printf("Skipping unknown packet (Op=%d) from player: %s\n", buf[0], from.toString().c_str());
+      printf("[room %d] Skipping unknown packet (Op=%d) from player: %s\n", id, hdr->op, from.toString().c_str());
+      metrics.drop(DropReason::Malformed);
       break;
     }
+  }
 
-    return true;
+  bool isEmpty() const override { return session.players.empty(); }
+  int playerCount() const override { return (int)session.players.size(); }
+
+private:
+  // The bots play the first 'botCount' hero slots, except the ones taken by players.
+  void updateBots()
+  {
+    if(!botCount)
+      return;
+
+    bool heroInUse[State::MAX_HEROES] {};
+    getHeroesInUse(session, heroInUse);
+
+    uint64_t botMask = 0;
+
+    for(int i = 0; i < botCount; ++i)
+    {
+      if(heroInUse[i])
+        continue;
+
+      botMask |= 1ull << i;
+
+      if(!state.heroes[i].enable)
+      {
+        state.heroes[i].enable = true;
+        stateModified = true;
+      }
+    }
+
+    bots.think(state, botMask, inputs, botBudgetNs);
+  }
+
+  const StateEncoding encoding;
+  const int botCount;
+  const int64_t botBudgetNs;
+  BotTeam<State> bots;
+  GameSession session {};
+  BasicGameMatch<State> match;
+  State state;
+  PlayerInputState inputs[State::MAX_HEROES] {};
+  InputQueue inputQueues[State::MAX_HEROES]; // of the players, by hero
+
+  std::unique_ptr<BasicDemoWriter<State>> recorder;
+  bool stateModified = false; // by something else than the simulation
+
+  uint32_t tickCount = 0;
+  uint32_t seq = 0;
+  uint64_t lastHash = 0; // of the snapshot 'seq'
+  uint32_t lastTick = 0; // of the snapshot 'seq'
+  Snapshot snapshots[SnapshotHistory];
+
+  static constexpr int MaxFrags = fragmentCount<State>();
+
+  struct EncodedPacket
+  {
+    uint32_t requestedBaseSeq;
+    int fragCount;
+    int sizes[MaxFrags];
+    PacketState frags[MaxFrags];
   };
+
+  // State packets of the current tick, one per distinct baseline
+  EncodedPacket encoded[State::MAX_HEROES];
+  int encodedCount = 0;
+  const EncodedPacket* playerPackets[State::MAX_HEROES]; // by player, null if up to date
+
+  std::vector<PacketState> sent; // the datagrams of the current tick, addressed to each player
+
+  uint8_t payload[Snapshot::Capacity]; // before fragmentation
+
+  const Snapshot* findSnapshot(uint32_t wantedSeq) const
+  {
+    auto& snapshot = snapshots[wantedSeq % SnapshotHistory];
+
+    if(wantedSeq == 0 || snapshot.seq != wantedSeq)
+      return nullptr;
+
+    return &snapshot;
+  }
+
+  const EncodedPacket& encodeStatePacket(const Snapshot& curr, const Snapshot* base)
+  {
+    const uint32_t baseSeq = base ? base->seq : 0;
+
+    for(int i = 0; i < encodedCount; ++i)
+    {
+      if(encoded[i].requestedBaseSeq == baseSeq)
+        return encoded[i];
+    }
+
+    auto& r = encoded[encodedCount++];
+    r.requestedBaseSeq = baseSeq;
+
+    uint32_t pktBaseSeq = baseSeq;
+    Span<const uint8_t> src { payload, -1 };
+
+    if(base)
+      src.len = encodeDelta({ base->data, base->size }, { curr.data, curr.size }, { payload, curr.size });
+
+    // fallback to a keyframe
+    if(src.len < 0 || src.len >= curr.size)
+    {
+      pktBaseSeq = 0;
+      src = { curr.data, curr.size };
+    }
+
+    // split into datagrams
+    r.fragCount = std::max(1, (src.len + FragmentSize - 1) / FragmentSize);
+
+    for(int i = 0; i < r.fragCount; ++i)
+    {
+      auto& pkt = r.frags[i];
+      const int offset = i * FragmentSize;
+      const int size = std::min(FragmentSize, src.len - offset);
+      pkt.hdr.op = Op::State;
+      pkt.hdr.roomId = id;
+      pkt.instance = instance;
+      pkt.seq = curr.seq;
+      pkt.baseSeq = pktBaseSeq;
+      pkt.fragIndex = i;
+      pkt.fragCount = r.fragCount;
+      pkt.fixedPoint = match.fixedPoint;
+      pkt.tick = lastTick;
+      pkt.stateHash = lastHash;
+      memcpy(pkt.payload, src.data + offset, size);
+      r.sizes[i] = int(sizeof(PacketStateHeader)) + size;
+    }
+
+    return r;
+  }
 };
-}
 
-std::unique_ptr<ITickable> createServer(Socket& sock)
+// Hosts many independent matches behind a single socket.
+// Incoming packets are routed to their room using the room id from the header.
+struct Server : ITickable
 {
-  return std::make_unique<Server>(sock);
+  Server(Socket& sock_, const ServerConfig& config_)
+    : sock(sock_)
+    , config(config_)
+    , exporter(config_.metricsPath, config_.metricsPeriodMs * 1000000ll)
+  {
+    printf("Max state packet size: %d\n", (int)sizeof(PacketState));
+  }
+
+  void tick() override
+  {
+    const int64_t t0 = getMonotonicTimeNs();
+
+    while(processIncomingPackets())
+    {
+    }
+
+    outgoing.clear();
+
+    for(auto& room : rooms)
+    {
+      room.second->tick();
+      room.second->broadcastNewState(outgoing);
+    }
+
+    const int dropped = sock.sendBatch(outgoing);
+    metrics.drops[(int)DropReason::SendFailed] += dropped;
+    metrics.packetsOut += (int)outgoing.size() - dropped;
+
+    for(auto& dg : outgoing)
+      metrics.bytesOut += dg.packet.len;
+
+    // close rooms whose players have all left
+    for(auto i = rooms.begin(); i != rooms.end();)
+    {
+      if(i->second->isEmpty())
+      {
+        printf("Closing room %d (%d rooms left)\n", i->first, (int)rooms.size() - 1);
+        i = rooms.erase(i);
+      }
+      else
+      {
+        ++i;
+      }
+    }
+
+    metrics.rooms = (int)rooms.size();
+    metrics.players = 0;
+
+    for(auto& room : rooms)
+      metrics.players += room.second->playerCount();
+
+    const int64_t t1 = getMonotonicTimeNs();
+    metrics.ticks++;
+    metrics.tickNsSum += t1 - t0;
+    metrics.tickNsMax = std::max(metrics.tickNsMax, t1 - t0);
+    exporter.update(metrics, t1);
+  }
+
+private:
+  static constexpr int RecvBatchSize = 64;
+
+  Socket& sock;
+  const ServerConfig config;
+  std::map<int, std::unique_ptr<Room>> rooms;
+  std::vector<OutgoingDatagram> outgoing;
+  uint8_t recvBuffers[RecvBatchSize][2048];
+
+  ServerMetrics metrics;
+  MetricsExporter exporter;
+
+  // Returns true if there might be more packets waiting.
+  bool processIncomingPackets()
+  {
+    IncomingDatagram slots[RecvBatchSize];
+
+    for(int i = 0; i < RecvBatchSize; ++i)
+      slots[i].buffer = recvBuffers[i];
+
+    const int n = sock.recvBatch(slots);
+
+    for(int i = 0; i < n; ++i)
+    {
+      metrics.packetsIn++;
+      metrics.bytesIn += slots[i].len;
+      processPacket(slots[i].sender, { slots[i].buffer.data, slots[i].len });
+    }
+
+    return n == RecvBatchSize;
+  }
+
+  void processPacket(Address from, Span<const uint8_t> buf)
+  {
+    if(buf.len < (int)sizeof(PacketHeader))
+    {
+      printf("Skipping truncated packet from: %s\n", from.toString().c_str());
+      metrics.drop(DropReason::Malformed);
+      return;
+    }
+
+    auto hdr = (const PacketHeader*)buf.data;
+
+    if(hdr->op == Op::QueryMetrics)
+    {
+      answerMetricsQuery(from);
+      return;
+    }
+
+    auto i = rooms.find(hdr->roomId);
+
+    if(i == rooms.end())
+    {
+      if(hdr->op != Op::KeepAlive)
+      {
+        metrics.drop(DropReason::UnknownRoom); // don't open a room for a stray packet
+        return;
+      }
+
+      if(hdr->roomId >= MaxRooms)
+      {
+        printf("Invalid room %d requested by: %s\n", hdr->roomId, from.toString().c_str());
+        metrics.drop(DropReason::Malformed);
+        return;
+      }
+
+      // older clients don't send the preset
+      auto preset = MapPreset::Classic;
+
+      if(buf.len >= (int)sizeof(PacketKeepAlive))
+        preset = ((const PacketKeepAlive*)buf.data)->preset;
+
+      if(preset >= MapPreset::Count)
+      {
+        printf("Invalid map preset %d requested by: %s\n", (int)preset, from.toString().c_str());
+        metrics.drop(DropReason::Malformed);
+        return;
+      }
+
+      printf("Opening room %d, map %s (%d rooms)\n", hdr->roomId, mapPresetName(preset), (int)rooms.size() + 1);
+      std::unique_ptr<Room> room;
+      visitPreset(preset, [&] (auto tag) { room = std::make_unique<RoomImpl<typename decltype(tag)::type>>(hdr->roomId, config, metrics); });
+      i = rooms.emplace(hdr->roomId, std::move(room)).first;
+    }
+
+    i->second->processPacket(from, buf);
+  }
+
+  void answerMetricsQuery(Address from)
+  {
+    // the metrics are for the operators, not for the players
+    if((from.address >> 24) != 127)
+    {
+      printf("Skipping metrics query from remote host: %s\n", from.toString().c_str());
+      metrics.drop(DropReason::Malformed);
+      return;
+    }
+
+    PacketMetrics pkt;
+    pkt.hdr.op = Op::Metrics;
+    pkt.hdr.roomId = 0;
+    pkt.truncated = false;
+
+    // cut after the last line that fits in each datagram
+    const auto& text = exporter.text();
+    std::vector<std::pair<int, int>> parts; // offset, length
+    int offset = 0;
+
+    do
+    {
+      if(parts.size() == MaxMetricsParts)
+      {
+        pkt.truncated = true;
+        break;
+      }
+
+      int len = std::min((int)text.size() - offset, (int)sizeof pkt.text);
+
+      if(offset + len < (int)text.size())
+      {
+        int end = len;
+
+        while(end > 0 && text[offset + end - 1] != '\n')
+          --end;
+
+        if(end > 0)
+          len = end;
+      }
+
+      parts.push_back({ offset, len });
+      offset += len;
+    }
+    while(offset < (int)text.size());
+
+    pkt.partCount = parts.size();
+
+    for(int i = 0; i < (int)parts.size(); ++i)
+    {
+      pkt.part = i;
+      memcpy(pkt.text, text.data() + parts[i].first, parts[i].second);
+      const int size = int(offsetof(PacketMetrics, text)) + parts[i].second;
+
+      if(sock.send(from, { (const uint8_t*)&pkt, size }))
+      {
+        metrics.packetsOut++;
+        metrics.bytesOut += size;
+      }
+      else
+      {
+        metrics.drop(DropReason::SendFailed);
+      }
+    }
+  }
+};
 }
 
+std::unique_ptr<ITickable> createServer(Socket& sock, const ServerConfig& config)
+{
+  return std::make_unique<Server>(sock, config);
+}
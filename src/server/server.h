@@ -2,6 +2,7 @@
 
 #include "socket.h"
 #include <memory>
+#include <string>
 
 struct ITickable
 {
@@ -9,5 +10,17 @@ struct ITickable
   virtual void tick() = 0;
 };
 
-std::unique_ptr<ITickable> createServer(Socket& sock);
+struct ServerConfig
+{
+  bool rawStates = false; // debug: send states as raw structs instead of bit-packed
+  std::string recordDir; // if not empty, record a demo of each room in this directory
+  bool instantChains = false; // rule for the rooms opened by this server, see GameMatch
+  bool fixedPoint = false; // simulation mode of the rooms opened by this server, see GameMatch
+  int bots = 0; // number of hero slots of each room played by bots, when no player takes them (at most spawnCount)
+  int botBudgetUs = 100; // time the bots of a room can spend thinking, per tick
+  std::string metricsPath; // if not empty, periodically export the metrics to this file (see metrics.h)
+  int metricsPeriodMs = 1000;
+};
+
+std::unique_ptr<ITickable> createServer(Socket& sock, const ServerConfig& config);
 